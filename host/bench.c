@@ -0,0 +1,1299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "sprites.h"
+#include "sprite_store.h"
+#include "point_sprite.h"
+#include "packed_vertex.h"
+#include "jobs.h"
+#include "profile.h"
+#include "bench_script.h"
+#include "dirty.h"
+#include "atlas_buckets.h"
+#include "sprite_order.h"
+#include "collision_grid.h"
+#include "sprite_world.h"
+#include "fixed_kinematics.h"
+#include "analytic_vertex.h"
+#include "uvlut_vertex.h"
+#include "split_vertex.h"
+#include "instanced_vertex.h"
+
+// Frame delta fed to the simulation, in milliseconds (a steady 60fps)
+#define FRAME_MS (1000.0f / 60.0f)
+#define NUM_EMOTES (46)
+// What every section's scene is scattered from
+#define BENCH_SEED (1)
+
+typedef struct {
+	int frames;
+	int num_counts;
+	int counts[16];
+	Tex3DS_Texture t3x_110;
+	Tex3DS_Texture t3x_64;
+} bench_config;
+
+typedef struct {
+	const char *name;
+	const char *description;
+	void (*run)(const bench_config *cfg);
+} bench_section;
+
+// Set when a section's self-check fails, so the run exits non-zero
+static bool failed;
+
+static void check(const char *label, int count, float error, float tolerance) {
+	bool ok = error <= tolerance;
+	printf("  %-24s %7d sprites  %9.4f max error  %s\n", label, count, error, ok ? "ok" : "FAILED");
+	if (!ok)
+		failed = true;
+}
+
+static void report(const char *label, int count, int frames, u64 ns) {
+	double per_frame = (double)ns / frames;
+	printf("  %-24s %7d sprites  %9.2f ns/sprite  %10.1f frames/sec\n",
+		label, count, per_frame / count, 1e9 / per_frame);
+}
+
+// Exit the run if a section could not allocate what count sprites need
+static void need(bool allocated, int count) {
+	if (!allocated) {
+		fprintf(stderr, "out of memory at %d sprites\n", count);
+		exit(1);
+	}
+}
+
+// The scene most sections start from: the first count sprites of store
+// scattered as the device would from seed
+static void scatter(sprite_store *store, int count, unsigned seed) {
+	srand(seed);
+	for (int i = 0; i < count; i++) {
+		spriteinfo s = sprite_random(NUM_EMOTES);
+		sprite_store_set(store, i, &s);
+	}
+}
+
+static void bench_update(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		spriteinfo *sprites = malloc(count * sizeof(spriteinfo));
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		need(sprites && vbo && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			sprites[i] = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, sprites[i].t3x_index);
+			add_rect(&vbo[i * SPRITE_VERTICES], sprites[i].x, sprites[i].y, sprites[i].z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+		}
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprites_update(sprites, vbo, count, FRAME_MS);
+		report("update", count, cfg->frames, host_nanotime() - start);
+
+		// The atlas switch rewrites every sprite's UVs
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			Tex3DS_Texture t3x = f & 1 ? cfg->t3x_110 : cfg->t3x_64;
+			for (int i = 0; i < count; i++)
+				uv_rect(&vbo[i * SPRITE_VERTICES], Tex3DS_GetSubTexture(t3x, sprites[i].t3x_index));
+		}
+		report("uv_rect", count, cfg->frames, host_nanotime() - start);
+
+		sprite_store_free(&store);
+		linearFree(vbo);
+		free(sprites);
+	}
+}
+
+static void bench_soa(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		spriteinfo *sprites = malloc(count * sizeof(spriteinfo));
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		need(sprites && vbo && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			sprites[i] = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, sprites[i].t3x_index);
+			add_rect(&vbo[i * SPRITE_VERTICES], sprites[i].x, sprites[i].y, sprites[i].z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+		}
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprites_update(sprites, vbo, count, FRAME_MS);
+		report("aos update+emit", count, cfg->frames, host_nanotime() - start);
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			sprite_store_emit(&store, vbo, 0, count);
+		}
+		report("soa update+emit", count, cfg->frames, host_nanotime() - start);
+
+		// Both layouts run the same arithmetic, so they must end up in lockstep
+		float max_error = 0.0f;
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			max_error = fmaxf(max_error, fmaxf(fabsf(s.x - sprites[i].x), fabsf(s.y - sprites[i].y)));
+		}
+		check("aos/soa divergence", count, max_error, 0.0f);
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_update(&store, 0, count, FRAME_MS);
+		report("soa update kernel", count, cfg->frames, host_nanotime() - start);
+
+		// Growing the pool keeps every sprite where it was
+		spriteinfo last = sprite_store_get(&store, count - 1);
+		start = host_nanotime();
+		bool grown = sprite_store_reserve(&store, count + 1);
+		report("grow by a chunk", count, 1, host_nanotime() - start);
+		spriteinfo moved = sprite_store_get(&store, count - 1);
+		bool same = last.x == moved.x && last.y == moved.y && last.z == moved.z &&
+			last.velocity_x == moved.velocity_x && last.velocity_y == moved.velocity_y && last.t3x_index == moved.t3x_index &&
+			last.atlas == moved.atlas;
+		check("grown pool", count, grown && same && store.capacity % SPRITE_POOL_CHUNK == 0 ? 0.0f : 1.0f, 0.0f);
+
+		sprite_store_free(&store);
+		linearFree(vbo);
+		free(sprites);
+	}
+}
+
+static void bench_indexed(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		need(vbo && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit(&store, vbo, 0, count);
+		report("emit 6 vertices", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * SPRITE_VERTICES * 3 * sizeof(float));
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_quads(&store, vbo, 0, count);
+		report("emit 4 vertices", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * SPRITE_QUAD_VERTICES * 3 * sizeof(float));
+
+		sprite_store_free(&store);
+		linearFree(vbo);
+	}
+}
+
+static float vertex_error(const vertex *a, const vertex *b, int count) {
+	float error = 0.0f;
+	for (int i = 0; i < count; i++) {
+		error = fmaxf(error, fabsf(a[i].x - b[i].x));
+		error = fmaxf(error, fabsf(a[i].y - b[i].y));
+		error = fmaxf(error, fabsf(a[i].z - b[i].z));
+		error = fmaxf(error, fabsf(a[i].u - b[i].u));
+		error = fmaxf(error, fabsf(a[i].v - b[i].v));
+	}
+	return error;
+}
+
+static void bench_points(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		point_sprite *points = linearAlloc(count * sizeof(point_sprite));
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		need(points && vbo && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index);
+			add_rect(&vbo[i * SPRITE_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+			point_sprite_set(&points[i], s.x, s.y, s.z, ts);
+		}
+
+		// The geometry shader must reproduce the quads the CPU paths write
+		float error = 0.0f;
+		for (int i = 0; i < count; i++) {
+			vertex expanded[SPRITE_VERTICES];
+			point_sprite_expand(&points[i], SPRITE_WIDTH, SPRITE_HEIGHT, expanded);
+			error = fmaxf(error, vertex_error(expanded, &vbo[i * SPRITE_VERTICES], SPRITE_VERTICES));
+		}
+		check("expanded/add_rect", count, error, 0.0f);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			point_sprites_emit(&store, points, 0, count);
+		report("emit 1 point", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * 3 * sizeof(float));
+
+		sprite_store_free(&store);
+		linearFree(vbo);
+		linearFree(points);
+	}
+}
+
+// Every vertex the uv table shader draws from lut against the quads in vbo
+static float uvlut_error(const uvlut_vertex *lut, const uvlut_table *table, const vertex *vbo, int count) {
+	float error = 0.0f;
+	for (int i = 0; i < count * SPRITE_QUAD_VERTICES; i++) {
+		vertex v = uvlut_vertex_at(&lut[i], table, SPRITE_WIDTH, SPRITE_HEIGHT);
+		error = fmaxf(error, vertex_error(&v, &vbo[i], 1));
+	}
+	return error;
+}
+
+static void bench_uvlut(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		uvlut_vertex *lut = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(uvlut_vertex));
+		sprite_store store;
+		uvlut_table table;
+		need(vbo && lut && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			add_quad(&vbo[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT,
+				Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index));
+			add_uvlut_quad(&lut[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, s.t3x_index);
+		}
+
+		// The shader's lookup must land on the texcoords the CPU paths
+		// write, give or take the rounding of left + (right - left)
+		bool fits = uvlut_table_for(&table, cfg->t3x_110);
+		float error = fits ? uvlut_error(lut, &table, vbo, count) : 1.0f;
+
+		// Switching atlases: every texcoord rewritten, or one table
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			Tex3DS_Texture t3x = f & 1 ? cfg->t3x_110 : cfg->t3x_64;
+			for (int i = 0; i < count; i++)
+				uv_quad(&vbo[i * SPRITE_QUAD_VERTICES], Tex3DS_GetSubTexture(t3x, store.t3x_index[i]));
+		}
+		report("uv_quad atlas switch", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/switch\n", "", count, count * SPRITE_QUAD_VERTICES * 2 * sizeof(float));
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			fits &= uvlut_table_for(&table, f & 1 ? cfg->t3x_110 : cfg->t3x_64);
+		report("uv table atlas switch", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/switch\n", "", count, sizeof(uvlut_table));
+
+		// Both ended on the same atlas, with the vertices left alone
+		error = fmaxf(error, fits ? uvlut_error(lut, &table, vbo, count) : 1.0f);
+		check("uv table/uv_quad", count, error, 1e-6f);
+
+		sprite_store_free(&store);
+		linearFree(lut);
+		linearFree(vbo);
+	}
+}
+
+// A float uniform as citro3d lays it out, w first
+typedef struct {float w; float z; float y; float x;} host_fvec;
+
+static void bench_instanced(const bench_config *cfg) {
+	instanced_vertex quads[INSTANCED_BATCH * SPRITE_QUAD_VERTICES];
+	instanced_quads(quads);
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		sprite_instance *instances = malloc(count * sizeof(sprite_instance));
+		// Stands in for the command buffer every batch's upload goes into
+		host_fvec *uploads = malloc(count * sizeof(host_fvec));
+		sprite_store store;
+		uvlut_table table;
+		need(vbo && instances && uploads && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			add_quad(&vbo[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT,
+				Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index));
+			add_instance(&instances[i], s.x, s.y, s.z, s.t3x_index);
+		}
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_quads(&store, vbo, 0, count);
+		report("vbo rewrite", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame, %d draws\n", "", count,
+			count * SPRITE_QUAD_VERTICES * 3 * sizeof(float), (count + MAX_INDEXED_SPRITES - 1) / MAX_INDEXED_SPRITES);
+
+		// The instances, then their copy into the uniforms of every batch
+		int batches = (count + INSTANCED_BATCH - 1) / INSTANCED_BATCH;
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_emit_instances(&store, instances, 0, count);
+			for (int i = 0; i < count; i++) {
+				uploads[i].x = instances[i].x;
+				uploads[i].y = instances[i].y;
+				uploads[i].z = instances[i].z;
+				uploads[i].w = instances[i].entry;
+			}
+		}
+		report("instanced upload", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame, %d draws\n", "", count,
+			count * sizeof(sprite_instance), batches);
+
+		// Every batch's canned quads must land where the rewritten vertices
+		// are, give or take the rounding of the table's texcoords
+		float error = uvlut_table_for(&table, cfg->t3x_110) ? 0.0f : 1.0f;
+		for (int b = 0; b < batches; b++) {
+			sprite_instance batch[INSTANCED_BATCH];
+			int size = count - b * INSTANCED_BATCH < INSTANCED_BATCH ? count - b * INSTANCED_BATCH : INSTANCED_BATCH;
+			for (int i = 0; i < size; i++) {
+				const host_fvec *u = &uploads[b * INSTANCED_BATCH + i];
+				sprite_instance s = {u->x, u->y, u->z, u->w};
+				batch[i] = s;
+			}
+			for (int i = 0; i < size * SPRITE_QUAD_VERTICES; i++) {
+				vertex v = instanced_vertex_at(&quads[i], batch, &table, SPRITE_WIDTH, SPRITE_HEIGHT);
+				error = fmaxf(error, vertex_error(&v, &vbo[b * INSTANCED_BATCH * SPRITE_QUAD_VERTICES + i], 1));
+			}
+		}
+		check("instanced/vbo rewrite", count, error, 1e-6f);
+
+		sprite_store_free(&store);
+		free(uploads);
+		free(instances);
+		linearFree(vbo);
+	}
+}
+
+static void bench_split(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		split_position *positions = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(split_position));
+		split_uv *uvs = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(split_uv));
+		sprite_store store;
+		need(vbo && positions && uvs && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index);
+			add_quad(&vbo[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+			uv_split_quad(&uvs[i * SPRITE_QUAD_VERTICES], ts);
+		}
+
+		// Both write the same positions; what differs is how many cache lines
+		// around them get dirtied and flushed
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_quads(&store, vbo, 0, count);
+		report("interleaved move", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame touched\n", "", count, count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_split(&store, positions, 0, count);
+		report("split move", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame touched\n", "", count, count * SPRITE_QUAD_VERTICES * sizeof(split_position));
+
+		vertex *joined = malloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		for (int i = 0; i < count * SPRITE_QUAD_VERTICES; i++) {
+			vertex v = {positions[i].x, positions[i].y, positions[i].z, uvs[i].u, uvs[i].v};
+			joined[i] = v;
+		}
+		check("split/interleaved", count, vertex_error(joined, vbo, count * SPRITE_QUAD_VERTICES), 0.0f);
+
+		free(joined);
+		sprite_store_free(&store);
+		linearFree(uvs);
+		linearFree(positions);
+		linearFree(vbo);
+	}
+}
+
+static void bench_packed(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		packed_vertex *packed = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(packed_vertex));
+		sprite_store store;
+		need(vbo && packed && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index);
+			add_quad(&vbo[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+			add_packed_quad(&packed[i * SPRITE_QUAD_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+		}
+
+		// Positions round to 1/16 pixel, depth to 1/256 and texcoords to 1/32767
+		float position_error = 0.0f, uv_error = 0.0f;
+		for (int i = 0; i < count * SPRITE_QUAD_VERTICES; i++) {
+			vertex v = unpack_vertex(&packed[i]);
+			position_error = fmaxf(position_error, fmaxf(fabsf(v.x - vbo[i].x), fabsf(v.y - vbo[i].y)));
+			position_error = fmaxf(position_error, fabsf(v.z - vbo[i].z));
+			uv_error = fmaxf(uv_error, fmaxf(fabsf(v.u - vbo[i].u), fabsf(v.v - vbo[i].v)));
+		}
+		check("packed/float position", count, position_error, 0.5f / PACKED_POSITION_SCALE);
+		check("packed/float texcoord", count, uv_error, 0.5f / PACKED_UV_SCALE);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_quads(&store, vbo, 0, count);
+		report("emit float quads", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * SPRITE_QUAD_VERTICES * 3 * sizeof(float));
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_emit_packed(&store, packed, 0, count);
+		report("emit packed quads", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * SPRITE_QUAD_VERTICES * 3 * sizeof(s16));
+
+		sprite_store_free(&store);
+		linearFree(packed);
+		linearFree(vbo);
+	}
+}
+
+typedef struct {
+	sprite_store *store;
+	vertex *vbo;
+} update_job;
+
+static void update_chunk(void *ctx, int first, int count) {
+	update_job *job = ctx;
+	sprite_store_update(job->store, first, count, FRAME_MS);
+	sprite_store_emit(job->store, job->vbo, first, count);
+}
+
+static void bench_jobs(const bench_config *cfg) {
+	static const int thread_counts[] = {1, 2, 4};
+	job_system *js = jobs_create(JOBS_MAX_THREADS);
+	if (!js) {
+		fprintf(stderr, "could not start workers\n");
+		exit(1);
+	}
+
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		need(vbo && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, s.t3x_index);
+			add_rect(&vbo[i * SPRITE_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+		}
+
+		update_job job = {&store, vbo};
+		double single = 0.0;
+		for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+			int threads = thread_counts[t];
+			u64 start = host_nanotime();
+			for (int f = 0; f < cfg->frames; f++) {
+				PROFILE_ZONE("frame");
+				jobs_run(js, threads, update_chunk, &job, count, 64);
+			}
+			u64 ns = host_nanotime() - start;
+
+			char label[32];
+			snprintf(label, sizeof(label), "update+emit %d thread%s", threads, threads > 1 ? "s" : "");
+			report(label, count, cfg->frames, ns);
+			if (threads == 1)
+				single = ns;
+			else
+				printf("  %-24s %7d sprites  %9.2fx speedup\n", "", count, single / ns);
+		}
+
+		sprite_store_free(&store);
+		linearFree(vbo);
+	}
+
+	jobs_destroy(js);
+}
+
+static void bench_profile(const bench_config *cfg) {
+	// Enough zones to wrap the ring several times
+	int zones = cfg->frames * 64;
+	if (zones < PROFILE_RING_SIZE * 2)
+		zones = PROFILE_RING_SIZE * 2;
+
+	u32 before = profile_count();
+	u64 start = host_nanotime();
+	for (int i = 0; i < zones; i++) {
+		PROFILE_ZONE("empty");
+	}
+	u64 ns = host_nanotime() - start;
+	printf("  %-24s %7d zones    %9.2f ns/zone\n", "zone overhead", zones, (double)ns / zones);
+
+	// The ring keeps exactly the newest PROFILE_RING_SIZE zones, in order
+	int errors = profile_count() - before != (u32)zones;
+	profile_zone newer, older;
+	for (u32 i = 0; i + 1 < PROFILE_RING_SIZE; i++) {
+		if (!profile_get(i, &newer) || !profile_get(i + 1, &older))
+			errors++;
+		else if (older.start > newer.start || newer.end < newer.start || strcmp(newer.name, "empty"))
+			errors++;
+	}
+	if (profile_get(PROFILE_RING_SIZE, &older))
+		errors++;
+	check("ring order", PROFILE_RING_SIZE, errors, 0.0f);
+}
+
+static void bench_dirty(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store;
+		dirty_set dirty;
+		need(vbo && sprite_store_init(&store, count) && dirty_init(&dirty, count), count);
+
+		// Every other block of 256 sprites is at rest
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			if (i & 256)
+				store.velocity_x[i] = store.velocity_y[i] = 0.0f;
+		}
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			sprite_store_emit(&store, vbo, 0, count);
+		}
+		report("emit all", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B flushed\n", "", count, count * SPRITE_VERTICES * sizeof(vertex));
+
+		size_t flushed = 0;
+		int ranges = 0;
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			int first = 0;
+			for (int run; (run = sprite_store_next_moving(&store, &first, count)); first += run) {
+				sprite_store_emit(&store, vbo, first, run);
+				dirty_mark(&dirty, first, run);
+			}
+			ranges = dirty_collect(&dirty, count);
+			flushed = 0;
+			for (int r = 0; r < ranges; r++)
+				flushed += dirty.ranges[r].count * SPRITE_VERTICES * sizeof(vertex);
+		}
+		report("emit dirty ranges", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B flushed in %d ranges\n", "", count, flushed, ranges);
+
+		// Collected ranges cover every flagged sprite and leave no flags set
+		int errors = 0;
+		for (int i = 0; i < count; i += 97)
+			dirty_mark(&dirty, i, i % 5 + 1 < count - i ? i % 5 + 1 : count - i);
+		u8 *expected = malloc(count);
+		memcpy(expected, dirty.flags, count);
+		int n = dirty_collect(&dirty, count);
+		if (n > DIRTY_MAX_RANGES)
+			errors++;
+		for (int r = 0; r < n; r++)
+			for (int i = dirty.ranges[r].first; i < dirty.ranges[r].first + dirty.ranges[r].count; i++)
+				expected[i] = 0;
+		for (int i = 0; i < count; i++)
+			errors += expected[i] != 0 || dirty.flags[i] != 0;
+		check("dirty coverage", count, errors, 0.0f);
+		free(expected);
+
+		dirty_free(&dirty);
+		sprite_store_free(&store);
+		linearFree(vbo);
+	}
+}
+
+// Buckets the main loop draws from atlas 0, 1 and 2
+#define BENCH_ATLASES (3)
+
+// Count bucketing mistakes after showing the first shown sprites added. x
+// holds the order each sprite was added in.
+static int bucket_errors(const atlas_buckets *b, const sprite_store *store, int shown) {
+	int errors = 0, visible = 0;
+	for (int a = 0; a < b->num_buckets; a++) {
+		visible += b->visible[a];
+		for (int i = b->first[a]; i < b->first[a] + b->size[a]; i++) {
+			int k = i - b->first[a];
+			// Only this atlas, still in the order added, and drawn exactly
+			// when added among the first shown
+			errors += store->atlas[i] != a;
+			errors += k > 0 && store->x[i] <= store->x[i - 1];
+			errors += (k < b->visible[a]) != (store->x[i] < shown);
+		}
+	}
+	return errors + (visible != shown);
+}
+
+static void bench_buckets(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		int grown = count + SPRITE_POOL_CHUNK / 2;
+		sprite_store store;
+		atlas_buckets buckets = {0};
+		need(sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			store.x[i] = i;
+			store.atlas[i] = rand() % BENCH_ATLASES;
+		}
+
+		u64 start = host_nanotime();
+		bool sorted = atlas_buckets_sort(&buckets, &store, 0, count, BENCH_ATLASES);
+		report("sort by atlas", count, 1, host_nanotime() - start);
+
+		atlas_buckets_show(&buckets, count);
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			atlas_buckets_show(&buckets, f & 1 ? count : count - 100);
+		report("show +-100 sprites", 100, cfg->frames, host_nanotime() - start);
+
+		atlas_buckets_show(&buckets, count / 2);
+		int errors = sorted ? bucket_errors(&buckets, &store, count / 2) : 1;
+
+		// Sprites added to a sorted pool go after the ones already in their
+		// buckets
+		need(sprite_store_reserve(&store, grown), grown);
+		for (int i = count; i < grown; i++) {
+			spriteinfo s = sprite_random(NUM_EMOTES);
+			s.x = i;
+			s.atlas = rand() % BENCH_ATLASES;
+			sprite_store_set(&store, i, &s);
+		}
+		sorted = atlas_buckets_sort(&buckets, &store, count, grown, BENCH_ATLASES);
+		atlas_buckets_show(&buckets, count + 1);
+		errors += sorted ? bucket_errors(&buckets, &store, count + 1) : 1;
+		atlas_buckets_show(&buckets, 1);
+		errors += bucket_errors(&buckets, &store, 1);
+		check("bucket order", count, errors, 0.0f);
+
+		atlas_buckets_free(&buckets);
+		sprite_store_free(&store);
+	}
+}
+
+static void bench_cull(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store, view;
+		need(vbo && sprite_store_init(&store, count) && sprite_store_init(&view, count), count);
+
+		// A 3x arena, so roughly a ninth of the sprites are on screen
+		scatter(&store, count, BENCH_SEED);
+		sprite_store_set_arena(&store, count, GSP_SCREEN_HEIGHT_TOP);
+		for (int f = 0; f < 60; f++)
+			sprite_store_update(&store, 0, count, FRAME_MS);
+
+		int drawn = 0;
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			drawn = sprite_store_cull(&store, 0, count, 1.0f, &view, 0);
+			for (int i = 0; i < drawn; i++) {
+				const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(cfg->t3x_110, view.t3x_index[i]);
+				add_rect(&vbo[i * SPRITE_VERTICES], view.x[i], view.y[i], view.z[i], SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+			}
+		}
+		report("cull and emit on screen", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B written for %d on screen\n", "", count, drawn * SPRITE_VERTICES * sizeof(vertex), drawn);
+
+		// The packed sprites are exactly the on-screen ones, in store order
+		int errors = 0, j = 0;
+		for (int i = 0; i < count; i++) {
+			if (!sprite_store_on_screen(&store, i, 1.0f))
+				continue;
+			errors += j >= drawn || view.x[j] != store.x[i] || view.y[j] != store.y[i] || view.z[j] != store.z[i];
+			j++;
+		}
+		errors += j != drawn;
+		check("culled set", count, errors, 0.0f);
+
+		sprite_store_free(&view);
+		sprite_store_free(&store);
+		linearFree(vbo);
+	}
+}
+
+static const float *sort_z;
+
+static int compare_depth(const void *a, const void *b) {
+	int i = *(const int *)a, j = *(const int *)b;
+	if (sort_z[i] != sort_z[j])
+		return sort_z[i] < sort_z[j] ? 1 : -1;
+	return i - j;
+}
+
+// 0 if order[first, first + count) holds each sprite of the range once in
+// ascending key order, INFINITY otherwise
+static float order_error(const sprite_order *o, const sprite_store *store, int first, int count) {
+	u8 *seen = calloc(count, 1);
+	float error = 0.0f;
+	for (int k = first; k < first + count; k++) {
+		int i = o->order[k];
+		if (i < first || i >= first + count || seen[i - first]++)
+			error = INFINITY;
+		else if (k > first && o->key->key(store, o->order[k - 1]) > o->key->key(store, i))
+			error = INFINITY;
+	}
+	free(seen);
+	return error;
+}
+
+static void bench_order(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		sprite_store store;
+		sprite_order order = {.key = &sprite_order_depth};
+		int *reference = malloc(count * sizeof(int));
+		need(reference && sprite_store_init(&store, count) && sprite_order_reserve(&order, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_order_sort(&order, &store, 0, count);
+		report("radix sort front to back", count, cfg->frames, host_nanotime() - start);
+
+		for (int i = 0; i < count; i++)
+			reference[i] = i;
+		sort_z = store.z;
+		start = host_nanotime();
+		qsort(reference, count, sizeof(int), compare_depth);
+		report("qsort reference", count, 1, host_nanotime() - start);
+
+		// Every sprite appears once, each place is within a quantization step
+		// of the exact sort's, and sorting the second half keeps to it
+		float error = 0.0f;
+		u8 *seen = calloc(count, 1);
+		for (int i = 0; i < count; i++) {
+			if (seen[order.order[i]]++)
+				error = INFINITY;
+			error = fmaxf(error, fabsf(store.z[order.order[i]] - store.z[reference[i]]));
+		}
+		sprite_order_sort(&order, &store, count / 2, count - count / 2);
+		for (int i = count / 2; i < count; i++)
+			if (order.order[i] < count / 2)
+				error = INFINITY;
+		check("front-to-back order", count, error, DEEPNESS / 65535.0f);
+		free(seen);
+
+		// Half the pool sorted, then the rest merged in after the store moved
+		// up by one sprite, the way a bucket moves when the ones before it grow
+		sprite_order_sort(&order, &store, 0, count / 2);
+		float *scratch = malloc(count * sizeof(float));
+		for (int i = 0; i < count; i++)
+			reference[i] = (i + 1) % count;
+		sprite_store_permute(&store, reference, count, scratch);
+		free(scratch);
+		sprite_order_grow(&order, &store, 0, count / 2, 1, count - 1);
+		check("grown order", count, order_error(&order, &store, 1, count - 1), 0.0f);
+
+		// Depth never changes, so repairing only checks the order
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_order_repair(&order, &store, 1, count - 1);
+		report("repair depth order", count, cfg->frames, host_nanotime() - start);
+
+		// Rows change as sprites move, a little each frame
+		order.key = &sprite_order_rows;
+		sprite_order_sort(&order, &store, 0, count);
+		order.swaps = 0;
+		order.full_sorts = 0;
+		u64 elapsed = 0;
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			start = host_nanotime();
+			sprite_order_repair(&order, &store, 0, count);
+			elapsed += host_nanotime() - start;
+		}
+		report("repair rows order", count, cfg->frames, elapsed);
+		printf("  %-24s %7d sprites  %9d swaps/frame  %6d full sorts\n", "", count,
+			order.swaps / cfg->frames, order.full_sorts);
+		check("repaired order", count, order_error(&order, &store, 0, count), 0.0f);
+
+		sprite_order_free(&order);
+		sprite_store_free(&store);
+		free(reference);
+	}
+}
+
+static void bench_ecs(const bench_config *cfg) {
+	static const int ecs_threads[] = {1, 2, 4};
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		vertex *ecs_vbo = linearAlloc(count * SPRITE_VERTICES * sizeof(vertex));
+		sprite_store store, saved, initial;
+		sprite_world world;
+		need(vbo && ecs_vbo && sprite_store_init(&store, count) && sprite_store_init(&saved, count) &&
+			sprite_store_init(&initial, count) && sprite_world_init(&world), count);
+
+		scatter(&store, count, BENCH_SEED);
+		for (int i = 0; i < count; i++) {
+			spriteinfo s = sprite_store_get(&store, i);
+			sprite_store_set(&saved, i, &s);
+			sprite_store_set(&initial, i, &s);
+		}
+		u64 start = host_nanotime();
+		need(sprite_world_load(&world, &store, count), count);
+		report("flecs load", count, 1, host_nanotime() - start);
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			sprite_store_emit(&store, vbo, 0, count);
+		}
+		report("store update+emit", count, cfg->frames, host_nanotime() - start);
+
+		// One range over the whole pool, as a single bucket would give. Every
+		// thread count starts from the same sprites.
+		int first = 0;
+		sprite_world_frame frame = sprite_world_frame_for(&saved, &first, &count, 1);
+		frame.delta = FRAME_MS;
+		frame.vbo = ecs_vbo;
+		frame.layout = LAYOUT_RECTS;
+		// Same arithmetic, so on any number of threads the systems keep the
+		// hand-rolled update's pace to the bit, in the store they save to and
+		// in the vertices
+		float error = 0.0f;
+		for (size_t t = 0; t < sizeof(ecs_threads) / sizeof(ecs_threads[0]); t++) {
+			char label[32];
+			snprintf(label, sizeof(label), "flecs %d thread%s", ecs_threads[t], ecs_threads[t] > 1 ? "s" : "");
+			sprite_world_set_threads(&world, ecs_threads[t]);
+			sprite_world_load(&world, &initial, count);
+			start = host_nanotime();
+			for (int f = 0; f < cfg->frames; f++)
+				sprite_world_progress(&world, &frame);
+			report(label, count, cfg->frames, host_nanotime() - start);
+
+			for (int i = 0; i < count; i++) {
+				error = fmaxf(error, fmaxf(fabsf(saved.x[i] - store.x[i]), fabsf(saved.y[i] - store.y[i])));
+				error = fmaxf(error, fmaxf(fabsf(saved.velocity_x[i] - store.velocity_x[i]), fabsf(saved.velocity_y[i] - store.velocity_y[i])));
+			}
+			for (int i = 0; i < count * SPRITE_VERTICES; i++)
+				error = fmaxf(error, fmaxf(fabsf(ecs_vbo[i].x - vbo[i].x), fabsf(ecs_vbo[i].y - vbo[i].y)));
+		}
+		check("flecs/store divergence", count, error, 0.0f);
+
+		sprite_world_fini(&world);
+		sprite_store_free(&initial);
+		sprite_store_free(&saved);
+		sprite_store_free(&store);
+		linearFree(ecs_vbo);
+		linearFree(vbo);
+	}
+}
+
+// Fixed-point trajectories are followed for this many frames against the
+// float ones, on pools of up to FIXED_CHECK_MAX sprites
+#define FIXED_CHECK_FRAMES (10000)
+#define FIXED_CHECK_MAX (15000)
+
+static void bench_fixed(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		sprite_store store;
+		fixed_kinematics fixed = {0};
+		need(sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+		need(fixed_kinematics_load(&fixed, &store, count), count);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			sprite_store_update(&store, 0, count, FRAME_MS);
+		report("float update kernel", count, cfg->frames, host_nanotime() - start);
+
+		start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++)
+			fixed_kinematics_update(&fixed, &store, 0, count, fixed_kinematics_ticks(&fixed, FRAME_MS));
+		report("fixed update kernel", count, cfg->frames, host_nanotime() - start);
+
+		// From the same snapped start, in the screen arena and the widest
+		// one, the float update and the packed one stay within a pixel
+		if (count <= FIXED_CHECK_MAX) {
+			sprite_store reference;
+			need(sprite_store_init(&reference, count), count);
+			float error = 0.0f;
+			for (int arena = 0; arena < 2; arena++) {
+				sprite_store_set_arena(&store, count, arena ? 1.5f * GSP_SCREEN_HEIGHT_TOP : 0.0f);
+				fixed_kinematics_load(&fixed, &store, count);
+				reference.margin = store.margin;
+				for (int i = 0; i < count; i++) {
+					spriteinfo s = sprite_store_get(&store, i);
+					sprite_store_set(&reference, i, &s);
+				}
+				for (int f = 0; f < FIXED_CHECK_FRAMES; f++) {
+					sprite_store_update(&reference, 0, count, FRAME_MS);
+					fixed_kinematics_update(&fixed, &store, 0, count, fixed_kinematics_ticks(&fixed, FRAME_MS));
+				}
+				for (int i = 0; i < count; i++)
+					error = fmaxf(error, fmaxf(fabsf(store.x[i] - reference.x[i]), fabsf(store.y[i] - reference.y[i])));
+			}
+			check("fixed/float trajectory", count, error, 1.0f);
+			sprite_store_free(&reference);
+		}
+
+		fixed_kinematics_free(&fixed);
+		sprite_store_free(&store);
+	}
+}
+
+// The analytic wave is followed against a stepped bounce on pools of up to
+// ANALYTIC_CHECK_MAX sprites
+#define ANALYTIC_CHECK_MAX (15000)
+
+// Where vertex 0 of each sprite's quad is drawn ticks after the quads were
+// written, by the host reference of analytic.v.pica
+static void analytic_positions(const analytic_vertex *vbo, int count, float margin, float ticks, float *x, float *y) {
+	analytic_uniforms u = analytic_uniforms_for(margin);
+	for (int i = 0; i < count; i++) {
+		vertex v = analytic_vertex_at(&vbo[i * SPRITE_QUAD_VERTICES], &u, ticks);
+		x[i] = v.x;
+		y[i] = v.y;
+	}
+}
+
+static void bench_analytic(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		vertex *vbo = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(vertex));
+		analytic_vertex *analytic = linearAlloc(count * SPRITE_QUAD_VERTICES * sizeof(analytic_vertex));
+		float *x = malloc(count * sizeof(float)), *y = malloc(count * sizeof(float));
+		sprite_store store;
+		need(vbo && analytic && x && y && sprite_store_init(&store, count), count);
+
+		scatter(&store, count, BENCH_SEED);
+
+		u64 start = host_nanotime();
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			sprite_store_emit_quads(&store, vbo, 0, count);
+		}
+		report("store update+emit quads", count, cfg->frames, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9zu B/frame\n", "", count, count * SPRITE_QUAD_VERTICES * 3 * sizeof(float));
+
+		// The analytic path writes every vertex once, then nothing until
+		// the store catches up
+		start = host_nanotime();
+		for (int i = 0; i < count; i++)
+			add_analytic_quad(&analytic[i * SPRITE_QUAD_VERTICES], store.x[i], store.y[i], store.z[i],
+				store.velocity_x[i], store.velocity_y[i], SPRITE_WIDTH, SPRITE_HEIGHT, Tex3DS_GetSubTexture(cfg->t3x_110, store.t3x_index[i]));
+		report("analytic upload", count, 1, host_nanotime() - start);
+		start = host_nanotime();
+		analytic_advance(&store, 0, count, ANALYTIC_REBASE_TICKS);
+		report("analytic catch up", count, 1, host_nanotime() - start);
+		printf("  %-24s %7d sprites  %9d B/frame, %zu B every %.0f frames\n", "", count, 0,
+			count * SPRITE_QUAD_VERTICES * sizeof(analytic_vertex), ANALYTIC_REBASE_TICKS);
+
+		if (count <= ANALYTIC_CHECK_MAX) {
+			// Stepping a tick at a time and reflecting whatever overshoots
+			// an edge is the bounce the wave describes. In the screen arena
+			// and the widest one, the reference and what the store catches
+			// up to from halfway follow it over a whole clock.
+			float wave_error = 0.0f, catch_up_error = 0.0f;
+			double *px = malloc(count * sizeof(double)), *py = malloc(count * sizeof(double));
+			double *vx = malloc(count * sizeof(double)), *vy = malloc(count * sizeof(double));
+			need(px && py && vx && vy, count);
+			for (int arena = 0; arena < 2; arena++) {
+				scatter(&store, count, BENCH_SEED);
+				sprite_store_set_arena(&store, count, arena ? 1.5f * GSP_SCREEN_HEIGHT_TOP : 0.0f);
+				double low = -store.margin, high_x = GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH + store.margin;
+				double high_y = GSP_SCREEN_WIDTH - SPRITE_HEIGHT + store.margin;
+				for (int i = 0; i < count; i++) {
+					add_analytic_quad(&analytic[i * SPRITE_QUAD_VERTICES], store.x[i], store.y[i], store.z[i],
+						store.velocity_x[i], store.velocity_y[i], SPRITE_WIDTH, SPRITE_HEIGHT, Tex3DS_GetSubTexture(cfg->t3x_110, 0));
+					px[i] = store.x[i];
+					py[i] = store.y[i];
+					vx[i] = store.velocity_x[i];
+					vy[i] = store.velocity_y[i];
+				}
+
+				// Ticks the vertices were written at
+				int half = (int)ANALYTIC_REBASE_TICKS / 2, written = 0;
+				for (int t = 1; t <= (int)ANALYTIC_REBASE_TICKS; t++) {
+					for (int i = 0; i < count; i++) {
+						px[i] += vx[i];
+						py[i] += vy[i];
+						if (px[i] < low || px[i] > high_x) {
+							px[i] = 2.0 * (px[i] < low ? low : high_x) - px[i];
+							vx[i] = -vx[i];
+						}
+						if (py[i] < low || py[i] > high_y) {
+							py[i] = 2.0 * (py[i] < low ? low : high_y) - py[i];
+							vy[i] = -vy[i];
+						}
+					}
+					if (t % 64)
+						continue;
+					analytic_positions(analytic, count, store.margin, (float)(t - written), x, y);
+					for (int i = 0; i < count; i++)
+						wave_error = fmaxf(wave_error, (float)fmax(fabs(x[i] - px[i]), fabs(y[i] - py[i])));
+					if (t != half)
+						continue;
+					// Carry on from new vertices written where the store
+					// caught up to
+					analytic_advance(&store, 0, count, (float)half);
+					for (int i = 0; i < count; i++)
+						catch_up_error = fmaxf(catch_up_error, fmaxf(fabsf(store.x[i] - x[i]), fabsf(store.y[i] - y[i])));
+					for (int i = 0; i < count; i++)
+						add_analytic_quad(&analytic[i * SPRITE_QUAD_VERTICES], store.x[i], store.y[i], store.z[i],
+							store.velocity_x[i], store.velocity_y[i], SPRITE_WIDTH, SPRITE_HEIGHT, Tex3DS_GetSubTexture(cfg->t3x_110, 0));
+					written = t;
+				}
+			}
+			check("analytic/bounce", count, wave_error, 1.0f / 64.0f);
+			check("analytic catch up", count, catch_up_error, 1.0f / 64.0f);
+			free(vy);
+			free(vx);
+			free(py);
+			free(px);
+		}
+
+		sprite_store_free(&store);
+		free(y);
+		free(x);
+		linearFree(analytic);
+		linearFree(vbo);
+	}
+}
+
+// Collisions are only benched up to COLLIDE_BENCH_MAX sprites: past that the
+// arena is packed so densely every sprite touches hundreds of others. The
+// O(n^2) reference only runs up to COLLIDE_CHECK_MAX.
+#define COLLIDE_BENCH_MAX (50000)
+#define COLLIDE_CHECK_MAX (15000)
+
+static void bench_collide(const bench_config *cfg) {
+	for (int c = 0; c < cfg->num_counts; c++) {
+		int count = cfg->counts[c];
+		if (count > COLLIDE_BENCH_MAX) {
+			printf("  %-24s %7d sprites  skipped, past %d\n", "collide", count, COLLIDE_BENCH_MAX);
+			continue;
+		}
+		sprite_store store;
+		collision_grid grid = {0};
+		need(sprite_store_init(&store, count), count);
+
+		// A 4x arena, the widest the device offers
+		scatter(&store, count, BENCH_SEED);
+		sprite_store_set_arena(&store, count, 1.5f * GSP_SCREEN_HEIGHT_TOP);
+
+		// Split like two atlas buckets, as the device builds it
+		int first[2] = {0, count / 3}, size[2] = {count / 3, count - count / 3};
+		u64 build = 0, collide = 0;
+		int contacts = 0;
+		for (int f = 0; f < cfg->frames; f++) {
+			sprite_store_update(&store, 0, count, FRAME_MS);
+			u64 start = host_nanotime();
+			need(collision_grid_build(&grid, &store, first, size, 2), count);
+			u64 built = host_nanotime();
+			contacts += collision_grid_collide(&grid, &store);
+			build += built - start;
+			collide += host_nanotime() - built;
+		}
+		report("build grid", count, cfg->frames, build);
+		report("collide neighbours", count, cfg->frames, collide);
+		printf("  %-24s %7d sprites  %9d pairs/frame  %6d contacts/frame\n", "", count,
+			grid.tested, contacts / cfg->frames);
+
+		// Every overlapping pair is found: the broad phase against testing
+		// all pairs. Collisions only trade velocity, so momentum stays.
+		if (count <= COLLIDE_CHECK_MAX) {
+			int overlaps = 0;
+			for (int i = 0; i < count; i++)
+				for (int j = i + 1; j < count; j++) {
+					float dx = store.x[j] - store.x[i], dy = store.y[j] - store.y[i];
+					float d2 = dx * dx + dy * dy;
+					overlaps += d2 < COLLISION_SIZE * COLLISION_SIZE && d2 > 0.0f;
+				}
+			double before_x = 0.0, before_y = 0.0, after_x = 0.0, after_y = 0.0;
+			for (int i = 0; i < count; i++) {
+				before_x += store.velocity_x[i];
+				before_y += store.velocity_y[i];
+			}
+			collision_grid_collide(&grid, &store);
+			for (int i = 0; i < count; i++) {
+				after_x += store.velocity_x[i];
+				after_y += store.velocity_y[i];
+			}
+			check("broad phase pairs", count, fabsf((float)(grid.overlaps - overlaps)), 0.0f);
+			check("momentum", count, (float)fmax(fabs(after_x - before_x), fabs(after_y - before_y)), 1e-3f);
+		}
+
+		collision_grid_free(&grid);
+		sprite_store_free(&store);
+	}
+}
+
+// Scatter DEFAULT_SPRITES sprites from SCRIPT_SEED and write their vertices
+static void script_scene(sprite_store *store, vertex *vbo, Tex3DS_Texture t3x) {
+	scatter(store, DEFAULT_SPRITES, SCRIPT_SEED);
+	for (int i = 0; i < DEFAULT_SPRITES; i++) {
+		spriteinfo s = sprite_store_get(store, i);
+		add_rect(&vbo[i * SPRITE_VERTICES], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT,
+			Tex3DS_GetSubTexture(t3x, s.t3x_index));
+	}
+}
+
+// Run the device's scripted ramp with the CPU side of a frame: the update,
+// vertex emission and the UV rebuild when a step switches atlas. There is
+// no GPU, so stereo steps cost the same as mono ones and GPU/cmdbuf are 0.
+static void script_pass(const bench_config *cfg, sprite_store *store, vertex *vbo, FILE *csv) {
+	script_run run;
+	script_scene(store, vbo, cfg->t3x_110);
+	script_start(&run, csv, cfg->frames);
+
+	bool large_atlas = true;
+	u64 last = host_nanotime();
+	while (script_running(&run)) {
+		script_step step = script_current(&run);
+		u64 start = host_nanotime();
+		if (step.large_atlas != large_atlas) {
+			large_atlas = step.large_atlas;
+			Tex3DS_Texture t3x = large_atlas ? cfg->t3x_110 : cfg->t3x_64;
+			for (int i = 0; i < DEFAULT_SPRITES; i++)
+				uv_rect(&vbo[i * SPRITE_VERTICES], Tex3DS_GetSubTexture(t3x, store->t3x_index[i]));
+		}
+		sprite_store_update(store, 0, step.sprites, SCRIPT_DELTA_MS);
+		sprite_store_emit(store, vbo, 0, step.sprites);
+		u64 end = host_nanotime();
+
+		script_sample sample = {(end - start) / 1e6, 0.0, 0.0, (end - last) / 1e6};
+		last = end;
+		script_frame(&run, &sample);
+	}
+}
+
+static void bench_script(const bench_config *cfg) {
+	vertex *vbo = linearAlloc(DEFAULT_SPRITES * SPRITE_VERTICES * sizeof(vertex));
+	sprite_store store, replay;
+	need(vbo && sprite_store_init(&store, DEFAULT_SPRITES) && sprite_store_init(&replay, DEFAULT_SPRITES), DEFAULT_SPRITES);
+
+	script_pass(cfg, &store, vbo, stdout);
+
+	// A second run from the same seed has to land on exactly the same scene
+	FILE *discard = fopen("/dev/null", "w");
+	script_pass(cfg, &replay, vbo, discard ? discard : stderr);
+	if (discard)
+		fclose(discard);
+
+	float error = 0.0f;
+	for (int i = 0; i < DEFAULT_SPRITES; i++) {
+		spriteinfo a = sprite_store_get(&store, i), b = sprite_store_get(&replay, i);
+		error = fmaxf(error, fmaxf(fabsf(a.x - b.x), fabsf(a.y - b.y)));
+	}
+	check("script replay", DEFAULT_SPRITES, error, 0.0f);
+
+	sprite_store_free(&replay);
+	sprite_store_free(&store);
+	linearFree(vbo);
+}
+
+static const bench_section sections[] = {
+	{"update", "AoS update()/move_rect() and the uv_rect() atlas rebuild", bench_update},
+	{"soa", "structure-of-arrays update kernel against the AoS loop", bench_soa},
+	{"indexed", "six-vertex against four-vertex indexed position writes", bench_indexed},
+	{"points", "geometry shader point writes and the reference expansion check", bench_points},
+	{"uvlut", "atlas switches as texcoord rewrites against a uniform table lookup", bench_uvlut},
+	{"instanced", "sprites uploaded as uniforms for batches of canned quads against rewriting vertices", bench_instanced},
+	{"split", "moving sprites with texcoords in a buffer of their own against interleaved vertices", bench_split},
+	{"packed", "packed short vertices against float quads, with a precision check", bench_packed},
+	{"jobs", "update and vertex emission split across 1, 2 and 4 threads", bench_jobs},
+	{"dirty", "rewriting only moving sprites and coalescing their flush ranges", bench_dirty},
+	{"buckets", "sorting the pool by atlas and showing prefixes of each bucket", bench_buckets},
+	{"cull", "packing on-screen sprites out of a 3x arena and writing only those", bench_cull},
+	{"order", "sorting sprites from scratch against qsort and repairing the order", bench_order},
+	{"ecs", "the sprite update as a flecs pipeline on 1-4 threads against the hand-rolled one", bench_ecs},
+	{"fixed", "packed 16-bit fixed-point kinematics against the float update", bench_fixed},
+	{"analytic", "sprites bounced by the vertex shader's clock against stepping them on the CPU", bench_analytic},
+	{"collide", "sprite collisions through a spatial hash grid in a 4x arena", bench_collide},
+	{"profile", "profiling zone overhead and ring buffer wrap-around", bench_profile},
+	{"script", "the device's scripted sprite ramp as CSV, and a replay check", bench_script},
+};
+
+#define NUM_SECTIONS (sizeof(sections) / sizeof(sections[0]))
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-f frames] [-s section] [-t] [sprite counts...]\n\n"
+		"  -t  write a Chrome trace of the last zones to stdout, the report to stderr\n\nsections:\n", argv0);
+	for (size_t i = 0; i < NUM_SECTIONS; i++)
+		fprintf(stderr, "  %-12s %s\n", sections[i].name, sections[i].description);
+}
+
+int main(int argc, char **argv) {
+	bench_config cfg = {.frames = 600};
+	const char *only = NULL;
+	bool trace = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+			cfg.frames = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			only = argv[++i];
+		} else if (!strcmp(argv[i], "-t")) {
+			trace = true;
+		} else if (argv[i][0] >= '0' && argv[i][0] <= '9' && cfg.num_counts < 16) {
+			cfg.counts[cfg.num_counts++] = atoi(argv[i]);
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (cfg.frames <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (!cfg.num_counts) {
+		int defaults[] = {DEFAULT_SPRITES, 15000, 150000};
+		cfg.num_counts = sizeof(defaults) / sizeof(defaults[0]);
+		memcpy(cfg.counts, defaults, sizeof(defaults));
+	}
+
+	// Keep stdout for the trace alone
+	FILE *trace_out = NULL;
+	if (trace) {
+		fflush(stdout);
+		trace_out = fdopen(dup(STDOUT_FILENO), "w");
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+
+	cfg.t3x_110 = host_atlas_create(NUM_EMOTES, 110);
+	cfg.t3x_64 = host_atlas_create(NUM_EMOTES, 64);
+
+	int ran = 0;
+	for (size_t i = 0; i < NUM_SECTIONS; i++) {
+		if (only && strcmp(only, sections[i].name))
+			continue;
+		printf("%s: %d frames\n", sections[i].name, cfg.frames);
+		sections[i].run(&cfg);
+		ran++;
+	}
+
+	Tex3DS_TextureFree(cfg.t3x_110);
+	Tex3DS_TextureFree(cfg.t3x_64);
+
+	if (trace_out) {
+		profile_write_trace(trace_out);
+		fclose(trace_out);
+	}
+
+	if (!ran) {
+		usage(argv[0]);
+		return 1;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <time.h>
+#include "host_3ds.h"
+
+struct Tex3DS_Texture_s {
+	size_t num_subtextures;
+	Tex3DS_SubTexture subtextures[];
+};
+
+size_t Tex3DS_GetNumSubTextures(const Tex3DS_Texture texture) {
+	return texture->num_subtextures;
+}
+
+const Tex3DS_SubTexture *Tex3DS_GetSubTexture(const Tex3DS_Texture texture, size_t index) {
+	if (index >= texture->num_subtextures)
+		return NULL;
+	return &texture->subtextures[index];
+}
+
+void Tex3DS_TextureFree(Tex3DS_Texture texture) {
+	free(texture);
+}
+
+Tex3DS_Texture host_atlas_create(size_t count, u16 sprite_size) {
+	Tex3DS_Texture t3x = malloc(sizeof(*t3x) + count * sizeof(Tex3DS_SubTexture));
+	if (!t3x)
+		return NULL;
+
+	size_t per_row = 1;
+	while (per_row * per_row < count)
+		per_row++;
+	size_t tex_size = 8;
+	while (tex_size < per_row * sprite_size)
+		tex_size *= 2;
+
+	t3x->num_subtextures = count;
+	for (size_t i = 0; i < count; i++) {
+		float left = (float)(i % per_row * sprite_size) / tex_size;
+		float top = (float)(i / per_row * sprite_size) / tex_size;
+		Tex3DS_SubTexture ts = {
+			sprite_size, sprite_size,
+			// tex3ds flips V, so top is the larger coordinate
+			left, 1.0f - top,
+			left + (float)sprite_size / tex_size, 1.0f - top - (float)sprite_size / tex_size,
+		};
+		t3x->subtextures[i] = ts;
+	}
+
+	return t3x;
+}
+
+void *linearAlloc(size_t size) {
+	// libctru aligns linear heap allocations to 0x80 bytes
+	return aligned_alloc(0x80, (size + 0x7F) & ~(size_t)0x7F);
+}
+
+void linearFree(void *mem) {
+	free(mem);
+}
+
+Result GSPGPU_FlushDataCache(const void *adr, u32 size) {
+	(void)adr;
+	(void)size;
+	return 0;
+}
+
+u64 host_nanotime(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Minimal stand-in for the parts of libctru, citro3d and tex3ds the simulation
+// core touches, so it can be compiled and benchmarked on a development machine.
+// Nothing here talks to a GPU; linear memory is plain heap memory.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef s32 Result;
+
+#define GSP_SCREEN_WIDTH 240
+#define GSP_SCREEN_HEIGHT_TOP 400
+
+typedef struct {
+	u16 width;
+	u16 height;
+	float left;
+	float top;
+	float right;
+	float bottom;
+} Tex3DS_SubTexture;
+
+typedef struct Tex3DS_Texture_s *Tex3DS_Texture;
+
+size_t Tex3DS_GetNumSubTextures(const Tex3DS_Texture texture);
+const Tex3DS_SubTexture *Tex3DS_GetSubTexture(const Tex3DS_Texture texture, size_t index);
+void Tex3DS_TextureFree(Tex3DS_Texture texture);
+
+void *linearAlloc(size_t size);
+void linearFree(void *mem);
+Result GSPGPU_FlushDataCache(const void *adr, u32 size);
+
+// Fake atlas laid out like the tex3ds output for the emote sheets: count
+// subtextures of sprite_size pixels packed in rows of a square texture
+Tex3DS_Texture host_atlas_create(size_t count, u16 sprite_size);
+
+// Monotonic clock in nanoseconds
+u64 host_nanotime(void);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// The analytic clock counts in the update's unit of time: a sprite moves by
+// its velocity every 100/6 ms
+#define ANALYTIC_TICK_MS (100.0f / 6.0f)
+// The GPU's floats keep 16 bits of mantissa, so a sprite's distance along its
+// wave loses about 1/64 pixel per 1024 pixels travelled. Past this many ticks
+// the store catches up and the clock starts over.
+#define ANALYTIC_REBASE_TICKS (1024.0f)
+
+// A quad corner that moves itself: where its sprite was when the vertex was
+// written, the sprite's velocity in pixels per tick, and the corner's offset
+// from the sprite's top left. analytic.v.pica works out the rest from the
+// clock.
+typedef struct {
+	float x;
+	float y;
+	float z;
+	float velocity_x;
+	float velocity_y;
+	float corner_x;
+	float corner_y;
+	float u;
+	float v;
+} analytic_vertex;
+
+// The arena and period uniforms of analytic.v.pica: the span sprites' top
+// left corners roam in a store with margin, and their period along it
+typedef struct {
+	float arena[4];
+	float period[4];
+} analytic_uniforms;
+
+analytic_uniforms analytic_uniforms_for(float margin);
+
+// Four-vertex quads that move themselves, drawn with quad_indices()
+void add_analytic_quad(analytic_vertex *dest, float x, float y, float z, float velocity_x, float velocity_y,
+	float width, float height, const Tex3DS_SubTexture *ts);
+// Set the start position alone, which only matters with the clock at 0
+void move_analytic_quad(analytic_vertex *dest, float x, float y, float z);
+void uv_analytic_quad(analytic_vertex *dest, const Tex3DS_SubTexture *ts);
+
+// Rewrite the start positions of sprites [first, first + count)
+void sprite_store_emit_analytic(const sprite_store *store, analytic_vertex *vbo, int first, int count);
+
+// What analytic.v.pica computes for a vertex ticks after it was written,
+// step for step in 32-bit floats
+vertex analytic_vertex_at(const analytic_vertex *a, const analytic_uniforms *u, float ticks);
+
+// Move sprites [first, first + count) to where the shader draws them ticks
+// after they were written, turning round those on their way back, so new
+// vertices written from the store carry on from there with the clock at 0
+void analytic_advance(sprite_store *store, int first, int count, float ticks);
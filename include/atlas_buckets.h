@@ -0,0 +1,37 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Most atlases sprites can be drawn from
+#define MAX_ATLASES (4)
+
+// The pool sorted by atlas, so every atlas is drawn with one texture bind and
+// one draw. Bucket a holds store sprites [first[a], first[a] + size[a]), and
+// the first visible[a] of those are drawn.
+//
+// The sort is stable and each bucket stays in the order its sprites were
+// added, so drawing the first n sprites added draws a prefix of every bucket,
+// and changing n only moves where the prefixes end.
+typedef struct {
+	int first[MAX_ATLASES];
+	int size[MAX_ATLASES];
+	int visible[MAX_ATLASES];
+	int num_buckets;
+	// Sprites drawn over all buckets
+	int shown;
+	// Atlas of every sorted sprite, in the order they were added
+	u8 *added;
+	int sorted;
+} atlas_buckets;
+
+void atlas_buckets_free(atlas_buckets *b);
+
+// Sort store sprites [0, count) into num_buckets buckets by atlas, moving
+// them within the store. Sprites [0, sorted) must be where the last sort left
+// them and keep their place in the order; the rest are added after them in
+// store order. Pass sorted = 0 after reassigning atlases. Nothing is shown
+// afterwards. False if out of memory, with the store unchanged.
+bool atlas_buckets_sort(atlas_buckets *b, sprite_store *store, int sorted, int count, int num_buckets);
+
+// Show the first count sprites added
+void atlas_buckets_show(atlas_buckets *b, int count);
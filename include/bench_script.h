@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdio.h>
+#include "platform.h"
+
+// Seed the scene is regenerated from when a scripted run starts
+#define SCRIPT_SEED (0x3D5)
+// Frames a step runs before it is measured, letting counts and caches settle
+#define SCRIPT_WARMUP_FRAMES (30)
+// Simulation step of a scripted frame, in milliseconds (a steady 60fps)
+#define SCRIPT_DELTA_MS (1000.0f / 60.0f)
+// Parallax the stereo steps use in place of the 3D slider
+#define SCRIPT_IOD (1.0f)
+
+// One configuration of the ramp
+typedef struct {
+	int sprites;
+	bool large_atlas;
+	bool stereo;
+} script_step;
+
+// Costs of one frame; the host leaves the GPU fields at zero
+typedef struct {
+	double cpu_ms;
+	double gpu_ms;
+	double cmdbuf;
+	double frametime_ms;
+} script_sample;
+
+// Progress through the ramp, writing a CSV row per finished step. Not
+// running until script_start() or after csv is cleared.
+typedef struct {
+	FILE *csv;
+	int frames;
+	int step;
+	int frame;
+	script_sample sum;
+} script_run;
+
+// The ramp: 100 to DEFAULT_SPRITES sprites in steps of 200, each with both
+// atlases and with 3D off and on
+int script_num_steps(void);
+script_step script_get_step(int index);
+
+// Start at the first step with frames measured frames per step, writing the
+// CSV header to csv
+void script_start(script_run *run, FILE *csv, int frames);
+bool script_running(const script_run *run);
+script_step script_current(const script_run *run);
+// Account one frame of the current step. Returns true if that finished the
+// step, so the caller should apply script_current() before the next frame.
+bool script_frame(script_run *run, const script_sample *sample);
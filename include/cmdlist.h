@@ -0,0 +1,46 @@
+#pragma once
+
+#include <3ds.h>
+
+// Most words one patch can rewrite
+#define CMDLIST_MAX_PATCHES (8)
+
+// A copy of the GPU commands citro3d emitted between cmdlist_begin() and
+// cmdlist_end(), which can be appended to later frames' command buffers
+// without going through citro3d again. Only state that was dirty while
+// recording is in the list; everything else must still be set on the GPU
+// when it is replayed.
+typedef struct {
+	u32 *words;
+	u32 size;
+	u32 capacity;
+	// Command buffer offset at cmdlist_begin()
+	u32 start;
+} cmdlist;
+
+// Words of a recorded list that hold one changing value
+typedef struct {
+	u32 words[CMDLIST_MAX_PATCHES];
+	int count;
+} cmdlist_patch;
+
+void cmdlist_free(cmdlist *cl);
+
+void cmdlist_begin(cmdlist *cl);
+// Copy everything emitted since cmdlist_begin(); false if out of memory
+bool cmdlist_end(cmdlist *cl);
+void cmdlist_replay(const cmdlist *cl);
+
+// Find every recorded upload of component (0=x .. 3=w) of vertex shader
+// float uniform reg. Returns the number of words found.
+int cmdlist_find_uniform(const cmdlist *cl, int reg, int component, cmdlist_patch *patch);
+// Find every recorded write to GPU register reg. Returns the number found.
+int cmdlist_find_register(const cmdlist *cl, u32 reg, cmdlist_patch *patch);
+void cmdlist_patch_word(cmdlist *cl, const cmdlist_patch *patch, u32 value);
+// Rewrite only the index-th word found, for values that differ per draw
+void cmdlist_patch_nth(cmdlist *cl, const cmdlist_patch *patch, int index, u32 value);
+void cmdlist_patch_float(cmdlist *cl, const cmdlist_patch *patch, float value);
+
+// Finish a frame whose draws were all replayed. citro3d only flushes the
+// framebuffer after draws it issued itself.
+void cmdlist_end_frame(void);
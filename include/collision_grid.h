@@ -0,0 +1,47 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Sprites collide as circles this wide, about the emote inside the sprite.
+// Grid cells are as wide, so colliding sprites are always in the same or
+// neighbouring cells.
+#define COLLISION_SIZE (SPRITE_WIDTH / 2.0f)
+
+// A uniform grid over the arena, rebuilt every frame from sprite positions.
+// Sprites are counting-sorted by cell, so each cell is a run of entries and
+// the broad phase only pairs sprites in the same or neighbouring cells.
+typedef struct {
+	int cols;
+	int rows;
+	// Top left of the grid in screen pixels
+	float left;
+	float top;
+	// Entries of cell c are [cell_start[c], cell_start[c + 1])
+	int *cell_start;
+	int cell_capacity;
+	// Per entry: store index and collider centre, in cell order
+	int *index;
+	float *cx;
+	float *cy;
+	// Cell of each sprite while building, in insertion order
+	int *cell_of;
+	int count;
+	int capacity;
+	// Pairs the last collide tested, found overlapping, and bounced apart
+	int tested;
+	int overlaps;
+	int contacts;
+} collision_grid;
+
+void collision_grid_free(collision_grid *g);
+
+// Bin the sprites of num_ranges store ranges [first[r], first[r] + count[r])
+// by the cell their centre is in. The grid covers the store's arena; sprites
+// outside it are clamped to the edge cells. False if out of memory.
+bool collision_grid_build(collision_grid *g, const sprite_store *store, const int *first, const int *count, int num_ranges);
+
+// Test every pair of binned sprites in the same or neighbouring cells and
+// bounce overlapping ones that approach each other off like equal masses:
+// the velocity components along the line between them are swapped, which
+// keeps momentum and energy. Changes velocities only. Returns the contacts.
+int collision_grid_collide(collision_grid *g, sprite_store *store);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "platform.h"
+
+// Most ranges one collection produces; past that, the closest neighbours
+// are merged
+#define DIRTY_MAX_RANGES (32)
+// Clean runs shorter than this are flushed along with the dirty sprites
+// around them; a few extra cache lines cost less than another flush call
+#define DIRTY_MERGE_GAP (16)
+
+typedef struct {
+	int first;
+	int count;
+} dirty_range;
+
+// Per-sprite dirty flags, collected once a frame into coalesced ranges of
+// sprites whose vertices were rewritten
+typedef struct {
+	u8 *flags;
+	int capacity;
+	dirty_range ranges[DIRTY_MAX_RANGES];
+	int num_ranges;
+} dirty_set;
+
+bool dirty_init(dirty_set *set, int capacity);
+void dirty_free(dirty_set *set);
+// Grow to at least capacity sprites, keeping the flags set so far
+bool dirty_reserve(dirty_set *set, int capacity);
+
+// Flag sprites [first, first + count). Safe to call concurrently on
+// disjoint ranges.
+void dirty_mark(dirty_set *set, int first, int count);
+
+// Turn the flags of the first count sprites into ranges and clear them.
+// Returns the number of ranges.
+int dirty_collect(dirty_set *set, int count);
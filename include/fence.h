@@ -0,0 +1,24 @@
+#pragma once
+
+#include <3ds.h>
+
+// Frame fences: every frame handed to the GPU gets an increasing id, and the
+// GPU's command list interrupt counts the frames it finished, so the CPU can
+// tell when the GPU is done with the buffers a frame read.
+void fence_init(void);
+void fence_exit(void);
+
+// Call before C3D_FrameEnd(), and only if the frame put commands in the
+// command buffer: citro3d submits no list for an empty one. start is when
+// the frame's simulation step began, for the latency measurement. Returns
+// the frame's id.
+u32 fence_submit(u64 start);
+bool fence_done(u32 id);
+// Block until frame id has finished; returns the ticks spent waiting
+u64 fence_wait(u32 id);
+// Wait for every submitted frame
+void fence_drain(void);
+
+// Milliseconds from the simulation step to the GPU finishing, averaged over
+// the last few frames
+float fence_latency_ms(void);
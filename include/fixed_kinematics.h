@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Positions and velocities in 1/32 pixel, signed 16-bit: enough for the
+// widest arena's +-770 pixels around its centre
+#define FIXED_KINEMATICS_SCALE (32.0f)
+// Time one packed step advances: sprite_store_update() moves a sprite by its
+// velocity every 100/6 ms
+#define FIXED_KINEMATICS_TICK_MS (100.0f / 6.0f)
+
+// A fixed-point copy of the store's positions and velocities, x in the low
+// halfword of each word and y in the high one, so one packed 16-bit add
+// (SADD16 on the ARM11) moves a sprite. Positions count from the arena centre
+// and sit half a step off the pixel grid, so no sprite ever lands exactly on
+// an arena edge, where float rounding would decide whether it bounces.
+typedef struct {
+	u32 *position;
+	u32 *velocity;
+	int capacity;
+	// Milliseconds short of the next whole tick
+	float pending_ms;
+} fixed_kinematics;
+
+void fixed_kinematics_free(fixed_kinematics *k);
+
+// Copy in the store's first count sprites, and snap the store to what the
+// copy can represent so both agree. False if out of memory.
+bool fixed_kinematics_load(fixed_kinematics *k, sprite_store *store, int count);
+
+// Whole ticks to step for a frame delta milliseconds long, carrying the rest
+// over to the next frame
+int fixed_kinematics_ticks(fixed_kinematics *k, float delta);
+
+// Advance sprites [first, first + count) by ticks steps, bouncing off the
+// arena edges like sprite_store_update(), and write their positions back to
+// the store, and their velocities when they bounce
+void fixed_kinematics_update(fixed_kinematics *k, sprite_store *store, int first, int count, int ticks);
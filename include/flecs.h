@@ -2,6 +2,8 @@
 #define flecs_STATIC
 #define FLECS_CUSTOM_BUILD  // Don't build all addons
 #define FLECS_SYSTEM        // Build FLECS_SYSTEM
+#define FLECS_PIPELINE      // Build FLECS_PIPELINE, to run systems on worker threads
+#define FLECS_NO_OS_API_IMPL // Threads and time come from source/flecs_os.c
 
 /**
  * @file flecs.h
@@ -0,0 +1,6 @@
+#pragma once
+
+// Point flecs' OS API at libctru threads, light locks and condition variables
+// on the 3DS and at pthreads on the host, so the pipeline can run systems on
+// worker threads. Call before the first ecs_init().
+void flecs_os_init(void);
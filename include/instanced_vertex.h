@@ -0,0 +1,40 @@
+#pragma once
+
+#include "uvlut_vertex.h"
+
+// Sprites one draw covers. Their instances share the 96 float uniforms with
+// the uv table's 46 entries, the projection and the rest.
+#define INSTANCED_BATCH (32)
+
+// A corner of one of the canned quads in the static vertex buffer: which
+// instance of the batch it belongs to, and which corner it is (0 or 1 on each
+// axis). instanced.v.pica finds its sprite in the instance uniforms.
+typedef struct {
+	u8 slot;
+	u8 corner_x;
+	u8 corner_y;
+	u8 pad;
+} instanced_vertex;
+
+// What a sprite uploads per draw: its top left and its atlas entry, in the
+// order of a vec4 uniform
+typedef struct {
+	float x;
+	float y;
+	float z;
+	float entry;
+} sprite_instance;
+
+// INSTANCED_BATCH quads of four vertices, drawn with quad_indices()
+void instanced_quads(instanced_vertex *dest);
+
+void move_instance(sprite_instance *dest, float x, float y, float z);
+void add_instance(sprite_instance *dest, float x, float y, float z, int entry);
+
+// Rewrite the positions of sprites [first, first + count) in instances
+void sprite_store_emit_instances(const sprite_store *store, sprite_instance *instances, int first, int count);
+
+// What instanced.v.pica computes for a vertex with a batch of instances and
+// table uploaded
+vertex instanced_vertex_at(const instanced_vertex *p, const sprite_instance *batch, const uvlut_table *table,
+	float width, float height);
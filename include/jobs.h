@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Most threads a job system will split work across, the caller included
+#define JOBS_MAX_THREADS (4)
+
+// Processes [first, first + count) of a job's range
+typedef void (*job_func)(void *ctx, int first, int count);
+
+// A fixed pool of worker threads: libctru threads pinned to the spare cores
+// on the 3DS, pthreads on the host
+typedef struct job_system job_system;
+
+// Start threads - 1 workers; the caller of jobs_run() is always the first
+job_system *jobs_create(int threads);
+void jobs_destroy(job_system *js);
+
+// Number of threads jobs_run() can use, the caller included
+int jobs_threads(const job_system *js);
+
+#ifdef __3DS__
+#include <3ds.h>
+
+// Start the index-th worker thread of a pool on the core it should use: the
+// New 3DS' spare app core, then the system core, then whichever is free.
+// Shared with other thread pools so they land on the same cores.
+Thread jobs_start_thread(ThreadFunc entry, void *arg, size_t stack_size, int index);
+#endif
+
+// Split [0, count) into chunks of at least min_chunk items and run func on up
+// to threads threads. Returns once every chunk has finished, so it doubles as
+// the barrier before the results are handed to the GPU.
+void jobs_run(job_system *js, int threads, job_func func, void *ctx, int count, int min_chunk);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Fixed-point scales of the packed layout; the shader multiplies them back out
+#define PACKED_POSITION_SCALE (16.0f) // 1/16 pixel, enough for +-2048 pixels
+#define PACKED_DEPTH_SCALE (256.0f)
+#define PACKED_UV_SCALE (32767.0f)
+
+// Half the size of `vertex`: GPU_SHORT position and depth, GPU_SHORT texcoords
+typedef struct {s16 x; s16 y; s16 z; s16 u; s16 v;} packed_vertex;
+
+// Four-vertex quads in the packed layout, drawn with quad_indices()
+void add_packed_quad(packed_vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts);
+void move_packed_quad(packed_vertex *dest, float x, float y, float z, float width, float height);
+void uv_packed_quad(packed_vertex *dest, const Tex3DS_SubTexture *ts);
+
+// Rewrite the positions of sprites [first, first + count) in vbo
+void sprite_store_emit_packed(const sprite_store *store, packed_vertex *vbo, int first, int count);
+
+// What packed.v.pica reads back out of a packed vertex
+vertex unpack_vertex(const packed_vertex *p);
@@ -0,0 +1,12 @@
+#pragma once
+
+// The simulation core is shared between the 3DS build and the headless host
+// benchmark; on the host the libctru/citro3d/tex3ds calls it needs come from a
+// thin stand-in in host/.
+#ifdef __3DS__
+#include <3ds.h>
+#include <citro3d.h>
+#include <tex3ds.h>
+#else
+#include "host_3ds.h"
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// One vertex per sprite for the geometry shader path: the position changes
+// every frame, the atlas rect only on an atlas switch
+typedef struct {float x; float y; float z; float left; float top; float right; float bottom;} point_sprite;
+
+void point_sprite_set(point_sprite *dest, float x, float y, float z, const Tex3DS_SubTexture *ts);
+void point_sprite_uv(point_sprite *dest, const Tex3DS_SubTexture *ts);
+
+// Rewrite the positions of sprites [first, first + count) in points
+void point_sprites_emit(const sprite_store *store, point_sprite *points, int first, int count);
+
+// Host reference of gsprite.gsh.pica: the six vertices the geometry shader
+// emits for p, in the order add_rect() writes them
+void point_sprite_expand(const point_sprite *p, float width, float height, vertex *dest);
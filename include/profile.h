@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdio.h>
+#include "platform.h"
+
+// Finished zones kept for the trace; older ones are overwritten. A power of
+// two so the ring index is a mask.
+#define PROFILE_RING_SIZE (4096)
+
+// One timed span of one thread, in profile_ticks()
+typedef struct {
+	const char *name;
+	u64 start;
+	u64 end;
+	u32 thread;
+} profile_zone;
+
+// Started zone living on the caller's stack until its scope ends
+typedef struct {
+	const char *name;
+	u64 start;
+} profile_scope;
+
+// svcGetSystemTick() on the 3DS, CLOCK_MONOTONIC nanoseconds on the host
+u64 profile_ticks(void);
+double profile_ticks_to_us(u64 ticks);
+
+static inline profile_scope profile_scope_begin(const char *name) {
+	return (profile_scope){name, profile_ticks()};
+}
+
+// Append a finished zone; safe from any thread and never allocates
+void profile_scope_end(profile_scope *scope);
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Time the rest of the enclosing block as a zone called name (a string
+// literal, since only the pointer is kept)
+#define PROFILE_ZONE(name)                                                        \
+	profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)                      \
+		__attribute__((cleanup(profile_scope_end))) = profile_scope_begin(name)
+
+// Zones recorded since startup, including the ones the ring has dropped
+u32 profile_count(void);
+// Copy out the zone recorded index zones ago (0 = newest); false if dropped
+bool profile_get(u32 index, profile_zone *zone);
+
+// Write the ring, oldest first, as a Chrome trace (chrome://tracing or
+// Perfetto). Call while no other thread is recording.
+void profile_write_trace(FILE *f);
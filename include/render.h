@@ -0,0 +1,121 @@
+#pragma once
+
+#include <3ds.h>
+#include <citro3d.h>
+#include <tex3ds.h>
+#include "sprite_store.h"
+
+// citro3d's command buffer. The instanced path copies every sprite it draws
+// into it, so it is sized for that rather than citro3d's default.
+#define RENDER_CMDBUF_SIZE (C3D_DEFAULT_CMDBUF_SIZE * 4)
+
+// A shader program together with the uniforms every sprite shader declares
+typedef struct {
+	DVLB_s *dvlb;
+	shaderProgram_s program;
+	int uLoc_projection;
+	int uLoc_tint;
+	int uLoc_depthinfo;
+} sprite_program;
+
+bool sprite_program_load(sprite_program *sp, const u8 *shbin, u32 shbin_size);
+void sprite_program_free(sprite_program *sp);
+// Bind the program and set the uniforms that stay the same for every draw
+void sprite_program_bind(sprite_program *sp);
+// Set the per-eye parallax, the only uniform that changes between draws
+void sprite_program_parallax(const sprite_program *sp, float iod);
+
+// Projection every sprite program is bound with
+void render_set_projection(const C3D_Mtx *projection);
+
+// Attribute and buffer setup for a buffer of float `vertex`es
+void render_bind_vertices(const vertex *vbo);
+// Point the two-attribute vertex buffer at data without touching attributes
+void render_bind_buffer(const void *data, size_t stride);
+
+// Most vertex buffers a path cycles through
+#define VBO_RING_MAX (3)
+
+// A path's vertex buffers: one per frame in flight, so the CPU can fill one
+// while the GPU still reads another
+typedef struct {
+	void *slots[VBO_RING_MAX];
+	int num_slots;
+	int capacity;
+	// Bytes each sprite takes
+	size_t sprite_bytes;
+	int current;
+} vbo_ring;
+
+// Grow to at least slots buffers of capacity sprites. All contents are lost
+// and the first slot becomes current. On failure the ring is unchanged.
+bool vbo_ring_reserve(vbo_ring *ring, int capacity, int slots);
+// Reserve two rings at once, for paths that keep their vertices in both: on
+// failure neither ring changes
+bool vbo_ring_reserve_pair(vbo_ring *a, vbo_ring *b, int capacity, int slots);
+void vbo_ring_free(vbo_ring *ring);
+// Make slot the buffer writes and draws go to, returning it
+void *vbo_ring_select(vbo_ring *ring, int slot);
+size_t vbo_ring_memory(const vbo_ring *ring);
+// Flush sprites [first, first + count) of the current buffer
+size_t vbo_ring_flush(const vbo_ring *ring, int first, int count);
+
+// One way of getting the sprite store onto the top screen. All writers return
+// the number of bytes of GPU-visible memory they wrote.
+typedef struct {
+	const char *name;
+	sprite_program *program;
+	// Bytes move() writes per sprite
+	size_t move_bytes;
+	// Vertices (or indices) a single draw call submits per sprite
+	int draw_vertices;
+	vertex_layout layout;
+	bool (*init)(int capacity);
+	void (*exit)(void);
+	// Grow to at least slots vertex buffers of capacity sprites each. Their
+	// contents are lost, so rebuild afterwards, and bind again if this path
+	// is current. Only call once the GPU is done with the old buffers.
+	bool (*reserve)(int capacity, int slots);
+	// Direct writes and draws to vertex buffer slot, rebinding it
+	void (*select)(int slot);
+	// The selected buffer, for writers outside the path
+	void *(*vertices)(void);
+	// Linear memory held by the path's buffers, in bytes
+	size_t (*memory)(void);
+	// Make this path's program, attributes, buffers and invariant uniforms
+	// current
+	void (*bind)(void);
+	// Write complete vertices for sprites [first, first + count) into the
+	// selected buffer. Safe to call concurrently on disjoint ranges. None of
+	// the writers flush; pass what they wrote to flush() before drawing.
+	size_t (*rebuild)(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x);
+	// Rewrite texture coordinates of sprites [first, first + count) after an
+	// atlas switch
+	size_t (*retexture)(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x);
+	// Rewrite positions of sprites [first, first + count) after the
+	// simulation moved them. Safe to call concurrently on disjoint ranges.
+	size_t (*move)(const sprite_store *sprites, int first, int count);
+	// Flush the data cache over the vertices of sprites [first, first + count)
+	// so the GPU sees them. Returns the bytes flushed.
+	size_t (*flush)(int first, int count);
+	// Draw sprites [first, first + count) with the bound texture. Returns the
+	// number of draw calls it took.
+	int (*draw)(int first, int count, float iod);
+} render_path;
+
+extern const render_path path_arrays;
+extern const render_path path_indexed;
+extern const render_path path_points;
+extern const render_path path_packed;
+extern const render_path path_analytic;
+extern const render_path path_uvlut;
+extern const render_path path_split;
+extern const render_path path_instanced;
+
+// The analytic path draws sprites where they are ticks after their vertices
+// were written, bouncing in an arena margin pixels past the top screen
+void path_analytic_clock(float ticks, float margin);
+// The uv table path looks texcoords up in t3x's entries until told otherwise
+void path_uvlut_atlas(Tex3DS_Texture t3x);
+// ...and so does the instanced path
+void path_instanced_atlas(Tex3DS_Texture t3x);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// A quad corner split across two buffers: where it is, which changes every
+// time its sprite moves, and its texcoord, which only changes with its atlas
+// entry. Moving a sprite then dirties no cache lines of texcoords.
+typedef struct {
+	float x;
+	float y;
+	float z;
+} split_position;
+
+typedef struct {
+	float u;
+	float v;
+} split_uv;
+
+// Four-vertex quads, drawn with quad_indices()
+void move_split_quad(split_position *dest, float x, float y, float z, float width, float height);
+void uv_split_quad(split_uv *dest, const Tex3DS_SubTexture *ts);
+
+// Rewrite the positions of sprites [first, first + count) in positions
+void sprite_store_emit_split(const sprite_store *store, split_position *positions, int first, int count);
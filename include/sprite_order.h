@@ -0,0 +1,66 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Bits of key the radix sort orders by, in passes of 8
+#define SPRITE_ORDER_BITS (16)
+// A repair gives up and sorts from scratch past this many swaps per sprite
+#define SPRITE_ORDER_REPAIR_BUDGET (2)
+
+// What sprites are ordered by; smaller keys come first
+typedef struct {
+	const char *name;
+	u16 (*key)(const sprite_store *store, int i);
+	// Whether keys change as sprites move, so the order needs repairing
+	// every frame rather than only when sprites are added
+	bool moves;
+} sprite_order_key;
+
+// Front to back (descending z), so the depth test rejects what is behind
+extern const sprite_order_key sprite_order_depth;
+// Top to bottom of the screen, the painter's order for blended sprites
+extern const sprite_order_key sprite_order_rows;
+
+// A persistent permutation of store indices, sorted by key within each range
+// it was sorted over. Frames change few keys and move few sprites, so the
+// order is repaired in place instead of being sorted again.
+typedef struct {
+	const sprite_order_key *key;
+	int *order;
+	// Key of order[k] when it was last sorted or repaired
+	u16 *keys;
+	int capacity;
+	// Radix sort scratch
+	u16 *keys_temp;
+	int *order_temp;
+	// Swaps the last repairs made and how many of them gave up and sorted from
+	// scratch, until cleared by the caller
+	int swaps;
+	int full_sorts;
+} sprite_order;
+
+void sprite_order_free(sprite_order *o);
+// Grow to hold at least capacity sprites, keeping the order so far
+bool sprite_order_reserve(sprite_order *o, int capacity);
+
+// Order store sprites [first, first + count) by key into
+// order[first, first + count) from scratch. Equal keys keep store order.
+void sprite_order_sort(sprite_order *o, const sprite_store *store, int first, int count);
+
+// Take new keys for order[first, first + count) and fix the order with an
+// insertion sort, falling back to sprite_order_sort() past the swap budget.
+// Returns the number of swaps.
+int sprite_order_repair(sprite_order *o, const sprite_store *store, int first, int count);
+
+// A range of the store moved from old_first to first and grew from old_size
+// to size sprites, the new ones at its end. Move its order along and merge
+// the new sprites in, sorted on their own. Returns the number of old sprites
+// that moved, which count as swaps. Ranges that moved to higher indices must
+// be grown last to first.
+int sprite_order_grow(sprite_order *o, const sprite_store *store, int old_first, int old_size, int first, int size);
+
+// Copy the sprites of range [first, first + size) that are among its first
+// visible, and on screen if cull is set, into view in order, packed from
+// index dest on. Returns the number copied.
+int sprite_order_gather(const sprite_order *o, const sprite_store *store, int first, int size, int visible,
+	bool cull, float parallax, sprite_store *view, int dest);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sprites.h"
+
+// Arrays are aligned (and padded) to this many bytes so the update kernel can
+// use full vector loads
+#define SPRITE_STORE_ALIGN (16)
+// sprite_store_reserve() grows the store in multiples of this many sprites
+#define SPRITE_POOL_CHUNK (1024)
+
+// Structure-of-arrays sprite storage: the update kernel only streams the
+// position and velocity arrays, leaving depth and atlas index out of the cache
+typedef struct {
+	float *x;
+	float *y;
+	float *velocity_x;
+	float *velocity_y;
+	float *z;
+	u16 *t3x_index;
+	// Which atlas t3x_index is an entry of
+	u8 *atlas;
+	int capacity;
+	// Sprites bounce off the edges of an arena this many pixels past every
+	// side of the top screen; 0 keeps them on it
+	float margin;
+} sprite_store;
+
+bool sprite_store_init(sprite_store *store, int capacity);
+void sprite_store_free(sprite_store *store);
+// Grow to hold at least capacity sprites, keeping the existing ones. The new
+// sprites are zeroed. On failure the store is left as it was.
+bool sprite_store_reserve(sprite_store *store, int capacity);
+// Heap bytes held by the arrays
+size_t sprite_store_memory(const sprite_store *store);
+
+void sprite_store_set(sprite_store *store, int i, const spriteinfo *s);
+spriteinfo sprite_store_get(const sprite_store *store, int i);
+// Move sprite i to dest[i] for each of the first count sprites. dest must be
+// a permutation of [0, count); scratch must hold count floats.
+void sprite_store_permute(sprite_store *store, const int *dest, int count, void *scratch);
+
+// Advance sprites [first, first + count) by delta milliseconds, bouncing off
+// the arena edges. Branch-free so it vectorizes.
+void sprite_store_update(sprite_store *store, int first, int count, float delta);
+// Change the arena margin, moving the first count sprites so each keeps its
+// place relative to the arena
+void sprite_store_set_arena(sprite_store *store, int count, float margin);
+
+// Whether sprite i's quad overlaps the top screen once shifted sideways by
+// up to parallax * z pixels, the most either eye's depthinfo.x moves it
+static inline bool sprite_store_on_screen(const sprite_store *store, int i, float parallax) {
+	float shift = parallax * store->z[i];
+	if (shift < 0.0f)
+		shift = -shift;
+	return store->x[i] + SPRITE_WIDTH + shift > 0.0f && store->x[i] - shift < (float)GSP_SCREEN_HEIGHT_TOP &&
+		store->y[i] + SPRITE_HEIGHT > 0.0f && store->y[i] < (float)GSP_SCREEN_WIDTH;
+}
+
+// Copy what the vertex writers read of sprite i to sprite j of view
+static inline void sprite_store_gather(const sprite_store *store, int i, sprite_store *view, int j) {
+	view->x[j] = store->x[i];
+	view->y[j] = store->y[i];
+	view->z[j] = store->z[i];
+	view->t3x_index[j] = store->t3x_index[i];
+}
+
+// Copy the sprites of [first, first + count) that are on screen into view,
+// packed together from index dest on. Returns the number copied.
+int sprite_store_cull(const sprite_store *store, int first, int count, float parallax, sprite_store *view, int dest);
+
+// Find the next run of sprites in [*first, end) with a nonzero velocity,
+// the only ones an update moves. Moves *first to the start of the run and
+// returns its length, or 0 if there is none.
+int sprite_store_next_moving(const sprite_store *store, int *first, int end);
+
+// Rewrite the positions of sprites [first, first + count) in vbo
+void sprite_store_emit(const sprite_store *store, vertex *vbo, int first, int count);
+// ...for a four-vertex quad buffer
+void sprite_store_emit_quads(const sprite_store *store, vertex *vbo, int first, int count);
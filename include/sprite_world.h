@@ -0,0 +1,72 @@
+#pragma once
+
+#include "flecs.h"
+#include "sprite_store.h"
+
+// The sprite simulation as flecs components and systems, run side by side
+// with the hand-rolled sprite_store_update() to compare the two
+typedef struct {float x; float y;} Position;
+typedef struct {float x; float y;} Velocity;
+typedef struct {float z;} Depth;
+typedef struct {u16 t3x_index; u8 atlas;} AtlasIndex;
+
+extern ECS_COMPONENT_DECLARE(Position);
+extern ECS_COMPONENT_DECLARE(Velocity);
+extern ECS_COMPONENT_DECLARE(Depth);
+extern ECS_COMPONENT_DECLARE(AtlasIndex);
+
+// What one frame of the pipeline works on: the store ranges
+// [first[r], first[r] + count[r]) of num_ranges ranges, as the buckets give
+// them. Systems leave rows outside them alone.
+typedef struct {
+	const int *first;
+	const int *count;
+	int num_ranges;
+	// Milliseconds to advance by, or 0 to only emit
+	float delta;
+	// Where Emit writes positions, laid out as layout; NULL to skip it
+	void *vbo;
+	vertex_layout layout;
+	// Arena bounce limits, from the store's margin
+	float low_x, high_x, low_y, high_y;
+	// Save writes positions and velocities back to this store
+	sprite_store *store;
+	// Bytes Emit wrote, summed over the threads
+	size_t bytes;
+} sprite_world_frame;
+
+// Every entity has the same four components, so they share one table, and
+// entities are only ever added at its end. Row i of the table is sprite i of
+// the store the world was loaded from.
+//
+// Move and Bounce run in the OnUpdate phase, Save in PostUpdate and Emit in
+// OnStore. All of them are multi-threaded: each worker takes the same slice
+// of the table in every system, so no system reads a row another worker
+// writes, and the pipeline needs no sync points between them.
+typedef struct {
+	ecs_world_t *world;
+	ecs_entity_t load;
+	int count;
+	int threads;
+	// The systems' context for the frame being run. The world must not move
+	// once initialized.
+	sprite_world_frame frame;
+} sprite_world;
+
+bool sprite_world_init(sprite_world *w);
+void sprite_world_fini(sprite_world *w);
+
+// Split the systems across threads threads, the caller included
+void sprite_world_set_threads(sprite_world *w, int threads);
+
+// Grow to store's first count sprites and copy all of them in. False if out
+// of memory.
+bool sprite_world_load(sprite_world *w, const sprite_store *store, int count);
+
+// Run the pipeline over frame: advance the ranges by frame->delta with the
+// same arithmetic as sprite_store_update(), save them back to the store and
+// rewrite their positions in frame->vbo. Returns the bytes Emit wrote.
+size_t sprite_world_progress(sprite_world *w, const sprite_world_frame *frame);
+
+// A frame over ranges of store, its arena limits filled in
+sprite_world_frame sprite_world_frame_for(sprite_store *store, const int *first, const int *count, int num_ranges);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include "platform.h"
+
+// Sprites the scene starts with; the pool grows past it on demand
+#define DEFAULT_SPRITES (1500)
+// Most sprites the pool grows to
+#define MAX_SPRITES (65536)
+#define SPRITE_HEIGHT (64.0f)
+#define SPRITE_WIDTH (64.0f)
+#define MIN_DEPTH (-25.0f)
+#define MAX_DEPTH (10.0f)
+#define DEEPNESS (MAX_DEPTH - MIN_DEPTH)
+
+// Every sprite is drawn as two triangles
+#define SPRITE_VERTICES (6)
+// ...or as a quad of four shared corners and six indices
+#define SPRITE_QUAD_VERTICES (4)
+#define SPRITE_QUAD_INDICES (6)
+// Largest sprite count one u16 index buffer can address; indexed paths draw
+// more in batches of this many
+#define MAX_INDEXED_SPRITES (65536 / SPRITE_QUAD_VERTICES)
+
+typedef struct {float x; float y; float z; float u; float v;} vertex;
+
+// How a render path lays sprites out in its vertex buffers, for writers that
+// do not go through the path
+typedef enum {
+	LAYOUT_RECTS, // SPRITE_VERTICES vertex per sprite
+	LAYOUT_QUADS, // SPRITE_QUAD_VERTICES vertex per sprite
+	LAYOUT_POINTS, // one point_sprite per sprite
+	LAYOUT_PACKED_QUADS, // SPRITE_QUAD_VERTICES packed_vertex per sprite
+	LAYOUT_ANALYTIC_QUADS, // SPRITE_QUAD_VERTICES analytic_vertex per sprite
+	LAYOUT_UVLUT_QUADS, // SPRITE_QUAD_VERTICES uvlut_vertex per sprite
+	LAYOUT_SPLIT_QUADS, // SPRITE_QUAD_VERTICES split_position per sprite
+	LAYOUT_INSTANCES, // one sprite_instance per sprite
+} vertex_layout;
+typedef struct {float x; float y; float z; float velocity_x; float velocity_y; size_t t3x_index; u8 atlas;} spriteinfo;
+
+float randbetween(float min, float max);
+
+// Random on-screen sprite showing one of num_subtextures atlas entries
+spriteinfo sprite_random(size_t num_subtextures);
+
+void add_rect(vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts);
+void move_rect(vertex *dest, float x, float y, float z, float width, float height);
+void uv_rect(vertex *dest, const Tex3DS_SubTexture *ts);
+
+// Four-vertex versions of the above, for drawing with quad_indices()
+void add_quad(vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts);
+void move_quad(vertex *dest, float x, float y, float z, float width, float height);
+void uv_quad(vertex *dest, const Tex3DS_SubTexture *ts);
+void quad_indices(u16 *dest, int count);
+
+// Advance count sprites by delta milliseconds, bouncing off the top screen
+// edges, and rewrite their positions in vbo
+void sprites_update(spriteinfo *sprites, vertex *vbo, int count, float delta);
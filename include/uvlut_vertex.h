@@ -0,0 +1,40 @@
+#pragma once
+
+#include "sprite_store.h"
+
+// Atlas entries the shader's table holds: both atlases have 46 emotes, and
+// the table shares the 96 float uniforms with the projection and the rest
+#define UVLUT_ENTRIES (46)
+
+// A quad corner that names its atlas entry instead of carrying texcoords:
+// the sprite's top left, the entry, and which corner it is (0 or 1 on each
+// axis). uvlut.v.pica adds the sprite size and looks the entry's rect up in a
+// uniform table, so the vertices stay valid whichever atlas is bound.
+typedef struct {
+	float x;
+	float y;
+	float z;
+	u8 entry;
+	u8 corner_x;
+	u8 corner_y;
+	u8 pad;
+} uvlut_vertex;
+
+// The uniform table of an atlas: left, top, right, bottom of every entry
+typedef struct {
+	float rect[UVLUT_ENTRIES][4];
+} uvlut_table;
+
+// False if the atlas has more entries than the table holds
+bool uvlut_table_for(uvlut_table *table, Tex3DS_Texture t3x);
+
+// Four-vertex quads, drawn with quad_indices()
+void add_uvlut_quad(uvlut_vertex *dest, float x, float y, float z, int entry);
+void move_uvlut_quad(uvlut_vertex *dest, float x, float y, float z);
+void entry_uvlut_quad(uvlut_vertex *dest, int entry);
+
+// Rewrite the positions of sprites [first, first + count) in vbo
+void sprite_store_emit_uvlut(const sprite_store *store, uvlut_vertex *vbo, int first, int count);
+
+// What uvlut.v.pica computes for a vertex with table uploaded
+vertex uvlut_vertex_at(const uvlut_vertex *p, const uvlut_table *table, float width, float height);
@@ -0,0 +1,89 @@
+#include <math.h>
+#include "analytic_vertex.h"
+
+analytic_uniforms analytic_uniforms_for(float margin) {
+	float width = (float)GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH + 2.0f * margin;
+	float height = (float)GSP_SCREEN_WIDTH - SPRITE_HEIGHT + 2.0f * margin;
+	analytic_uniforms u = {
+		{-margin, -margin, width, height},
+		{1.0f / (2.0f * width), 1.0f / (2.0f * height), 2.0f * width, 2.0f * height},
+	};
+	return u;
+}
+
+void add_analytic_quad(analytic_vertex *dest, float x, float y, float z, float velocity_x, float velocity_y,
+	float width, float height, const Tex3DS_SubTexture *ts) {
+	move_analytic_quad(dest, x, y, z);
+	uv_analytic_quad(dest, ts);
+	for (int i = 0; i < SPRITE_QUAD_VERTICES; i++) {
+		dest[i].velocity_x = velocity_x;
+		dest[i].velocity_y = velocity_y;
+		dest[i].corner_x = i & 1 ? width : 0.0f;
+		dest[i].corner_y = i & 2 ? height : 0.0f;
+	}
+}
+
+void move_analytic_quad(analytic_vertex *dest, float x, float y, float z) {
+	for (int i = 0; i < SPRITE_QUAD_VERTICES; i++) {
+		dest[i].x = x;
+		dest[i].y = y;
+		dest[i].z = z;
+	}
+}
+
+void uv_analytic_quad(analytic_vertex *dest, const Tex3DS_SubTexture *ts) {
+	dest[0].u = ts->left;
+	dest[0].v = ts->top;
+	dest[1].u = ts->right;
+	dest[1].v = ts->top;
+	dest[2].u = ts->left;
+	dest[2].v = ts->bottom;
+	dest[3].u = ts->right;
+	dest[3].v = ts->bottom;
+}
+
+void sprite_store_emit_analytic(const sprite_store *store, analytic_vertex *vbo, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_analytic_quad(&vbo[i * SPRITE_QUAD_VERTICES], store->x[i], store->y[i], store->z[i]);
+}
+
+// Where along its period, in [0, 2 * size), a sprite travelling at velocity
+// from start is after ticks
+static inline float wave_phase(float start, float velocity, float ticks, float edge, float inverse_period, float period) {
+	float distance = -edge + (start + velocity * ticks);
+	float cycles = inverse_period * distance;
+	return period * (cycles - floorf(cycles));
+}
+
+// Out from the edge over the first half of the period, back over the second
+static inline float wave_position(float phase, float edge, float size) {
+	float offset = -size + phase;
+	return edge + (size - fmaxf(offset, -offset));
+}
+
+vertex analytic_vertex_at(const analytic_vertex *a, const analytic_uniforms *u, float ticks) {
+	float phase_x = wave_phase(a->x, a->velocity_x, ticks, u->arena[0], u->period[0], u->period[2]);
+	float phase_y = wave_phase(a->y, a->velocity_y, ticks, u->arena[1], u->period[1], u->period[3]);
+	vertex v = {
+		a->corner_x + wave_position(phase_x, u->arena[0], u->arena[2]),
+		a->corner_y + wave_position(phase_y, u->arena[1], u->arena[3]),
+		a->z,
+		a->u,
+		a->v,
+	};
+	return v;
+}
+
+void analytic_advance(sprite_store *store, int first, int count, float ticks) {
+	analytic_uniforms u = analytic_uniforms_for(store->margin);
+	for (int i = first; i < first + count; i++) {
+		float phase_x = wave_phase(store->x[i], store->velocity_x[i], ticks, u.arena[0], u.period[0], u.period[2]);
+		float phase_y = wave_phase(store->y[i], store->velocity_y[i], ticks, u.arena[1], u.period[1], u.period[3]);
+		store->x[i] = wave_position(phase_x, u.arena[0], u.arena[2]);
+		store->y[i] = wave_position(phase_y, u.arena[1], u.arena[3]);
+		if (phase_x > u.arena[2])
+			store->velocity_x[i] = -store->velocity_x[i];
+		if (phase_y > u.arena[3])
+			store->velocity_y[i] = -store->velocity_y[i];
+	}
+}
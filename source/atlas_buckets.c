@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string.h>
+#include "atlas_buckets.h"
+
+void atlas_buckets_free(atlas_buckets *b) {
+	free(b->added);
+	memset(b, 0, sizeof(*b));
+}
+
+bool atlas_buckets_sort(atlas_buckets *b, sprite_store *store, int sorted, int count, int num_buckets) {
+	u8 *added = realloc(b->added, count);
+	int *dest = malloc(count * sizeof(int));
+	float *scratch = malloc(count * sizeof(float));
+	if (added)
+		b->added = added;
+	if (!added || !dest || !scratch) {
+		free(dest);
+		free(scratch);
+		return false;
+	}
+	for (int i = sorted; i < count; i++)
+		added[i] = store->atlas[i];
+
+	// Counting sort: every sprite goes after the ones before it in its bucket
+	memset(b->size, 0, sizeof(b->size));
+	for (int i = 0; i < count; i++)
+		b->size[store->atlas[i]]++;
+	int next[MAX_ATLASES];
+	for (int a = 0, first = 0; a < num_buckets; first += b->size[a++]) {
+		b->first[a] = first;
+		next[a] = first;
+	}
+	for (int i = 0; i < count; i++)
+		dest[i] = next[store->atlas[i]]++;
+	sprite_store_permute(store, dest, count, scratch);
+
+	b->num_buckets = num_buckets;
+	b->sorted = count;
+	memset(b->visible, 0, sizeof(b->visible));
+	b->shown = 0;
+	free(dest);
+	free(scratch);
+	return true;
+}
+
+void atlas_buckets_show(atlas_buckets *b, int count) {
+	if (count > b->sorted)
+		count = b->sorted;
+	while (b->shown < count)
+		b->visible[b->added[b->shown++]]++;
+	while (b->shown > count)
+		b->visible[b->added[--b->shown]]--;
+}
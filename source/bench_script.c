@@ -0,0 +1,57 @@
+#include "bench_script.h"
+#include "sprites.h"
+
+#define RAMP_FIRST (100)
+#define RAMP_STEP (200)
+#define RAMP_STEPS ((DEFAULT_SPRITES - RAMP_FIRST) / RAMP_STEP + 1)
+
+int script_num_steps(void) {
+	return RAMP_STEPS * 4;
+}
+
+script_step script_get_step(int index) {
+	// Sprite count varies slowest so each count's four variants sit together
+	return (script_step){
+		RAMP_FIRST + index / 4 * RAMP_STEP,
+		!(index & 1),
+		(index & 2) != 0,
+	};
+}
+
+void script_start(script_run *run, FILE *csv, int frames) {
+	*run = (script_run){csv, frames};
+	fprintf(csv, "step,sprites,atlas,stereo,cpu_ms,gpu_ms,cmdbuf_pct,frametime_ms\n");
+}
+
+bool script_running(const script_run *run) {
+	return run->csv && run->step < script_num_steps();
+}
+
+script_step script_current(const script_run *run) {
+	return script_get_step(run->step);
+}
+
+bool script_frame(script_run *run, const script_sample *sample) {
+	if (!script_running(run))
+		return false;
+
+	if (run->frame++ >= SCRIPT_WARMUP_FRAMES) {
+		run->sum.cpu_ms += sample->cpu_ms;
+		run->sum.gpu_ms += sample->gpu_ms;
+		run->sum.cmdbuf += sample->cmdbuf;
+		run->sum.frametime_ms += sample->frametime_ms;
+	}
+	if (run->frame < SCRIPT_WARMUP_FRAMES + run->frames)
+		return false;
+
+	script_step step = script_current(run);
+	double n = run->frames;
+	fprintf(run->csv, "%d,%d,%d,%d,%.4f,%.4f,%.3f,%.4f\n",
+		run->step, step.sprites, step.large_atlas ? 110 : 64, step.stereo,
+		run->sum.cpu_ms / n, run->sum.gpu_ms / n, run->sum.cmdbuf / n * 100.0, run->sum.frametime_ms / n);
+
+	run->step++;
+	run->frame = 0;
+	run->sum = (script_sample){0};
+	return true;
+}
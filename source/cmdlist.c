@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cmdlist.h"
+
+// PICA200 registers of the vertex shader float uniform upload port
+#define REG_FLOATUNIFORM_CONFIG (0x2C0)
+#define REG_FLOATUNIFORM_DATA_FIRST (0x2C1)
+#define REG_FLOATUNIFORM_DATA_LAST (0x2C8)
+
+void cmdlist_free(cmdlist *cl)
+{
+	free(cl->words);
+	memset(cl, 0, sizeof(*cl));
+}
+
+void cmdlist_begin(cmdlist *cl)
+{
+	u32 *buf, size;
+	GPUCMD_GetBuffer(&buf, &size, &cl->start);
+	cl->size = 0;
+}
+
+bool cmdlist_end(cmdlist *cl)
+{
+	u32 *buf, size, offset;
+	GPUCMD_GetBuffer(&buf, &size, &offset);
+
+	u32 words = offset - cl->start;
+	if (words > cl->capacity) {
+		u32 *grown = realloc(cl->words, words * sizeof(u32));
+		if (!grown)
+			return false;
+		cl->words = grown;
+		cl->capacity = words;
+	}
+	memcpy(cl->words, &buf[cl->start], words * sizeof(u32));
+	cl->size = words;
+	return true;
+}
+
+void cmdlist_replay(const cmdlist *cl)
+{
+	GPUCMD_AddRawCommands(cl->words, cl->size);
+}
+
+// Call visit(cl, index, reg, ctx) for every parameter word of the list with
+// the register it is written to
+typedef void (*param_visitor)(const cmdlist *cl, u32 index, u32 reg, void *ctx);
+
+static void visit_params(const cmdlist *cl, param_visitor visit, void *ctx)
+{
+	// Each command is a parameter, a header and the remaining parameters,
+	// padded to an even number of words
+	for (u32 i = 0; i + 1 < cl->size;) {
+		u32 header = cl->words[i + 1];
+		u32 reg_id = header & 0xFFFF;
+		u32 params = ((header >> 20) & 0xFF) + 1;
+		bool consecutive = header >> 31;
+
+		for (u32 p = 0; p < params; p++)
+			visit(cl, p == 0 ? i : i + 1 + p, consecutive ? reg_id + p : reg_id, ctx);
+
+		u32 length = 1 + params;
+		i += length + (length & 1);
+	}
+}
+
+static void add_patch(cmdlist_patch *patch, u32 index)
+{
+	if (patch->count < CMDLIST_MAX_PATCHES)
+		patch->words[patch->count] = index;
+	// Counted even when full so a caller can tell it missed some
+	patch->count++;
+}
+
+typedef struct {
+	int reg;
+	int word_wanted;
+	int uniform;
+	int word;
+	cmdlist_patch *patch;
+} uniform_search;
+
+static void visit_uniform(const cmdlist *cl, u32 index, u32 reg, void *ctx)
+{
+	uniform_search *search = ctx;
+	if (reg == REG_FLOATUNIFORM_CONFIG) {
+		search->uniform = cl->words[index] & 0x7F;
+		search->word = 0;
+	} else if (reg >= REG_FLOATUNIFORM_DATA_FIRST && reg <= REG_FLOATUNIFORM_DATA_LAST && search->uniform >= 0) {
+		if (search->uniform == search->reg && search->word == search->word_wanted)
+			add_patch(search->patch, index);
+		if (++search->word == 4) {
+			search->word = 0;
+			search->uniform++;
+		}
+	}
+}
+
+int cmdlist_find_uniform(const cmdlist *cl, int reg, int component, cmdlist_patch *patch)
+{
+	// citro3d uploads uniforms in f32 mode: a config write selects the first
+	// register, then each data write fills one word, w first and x last
+	uniform_search search = {reg, 3 - component, -1, 0, patch};
+	patch->count = 0;
+	visit_params(cl, visit_uniform, &search);
+	return patch->count;
+}
+
+typedef struct {
+	u32 reg;
+	cmdlist_patch *patch;
+} register_search;
+
+static void visit_register(const cmdlist *cl, u32 index, u32 reg, void *ctx)
+{
+	register_search *search = ctx;
+	if (reg == search->reg)
+		add_patch(search->patch, index);
+}
+
+int cmdlist_find_register(const cmdlist *cl, u32 reg, cmdlist_patch *patch)
+{
+	register_search search = {reg, patch};
+	patch->count = 0;
+	visit_params(cl, visit_register, &search);
+	return patch->count;
+}
+
+void cmdlist_patch_word(cmdlist *cl, const cmdlist_patch *patch, u32 value)
+{
+	for (int i = 0; i < patch->count && i < CMDLIST_MAX_PATCHES; i++)
+		cl->words[patch->words[i]] = value;
+}
+
+void cmdlist_patch_nth(cmdlist *cl, const cmdlist_patch *patch, int index, u32 value)
+{
+	if (index < patch->count && index < CMDLIST_MAX_PATCHES)
+		cl->words[patch->words[index]] = value;
+}
+
+void cmdlist_patch_float(cmdlist *cl, const cmdlist_patch *patch, float value)
+{
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	cmdlist_patch_word(cl, patch, bits);
+}
+
+void cmdlist_end_frame(void)
+{
+	GPUCMD_AddWrite(GPUREG_FRAMEBUFFER_FLUSH, 1);
+	GPUCMD_AddWrite(GPUREG_FRAMEBUFFER_INVALIDATE, 1);
+	GPUCMD_AddWrite(GPUREG_EARLYDEPTH_CLEAR, 1);
+}
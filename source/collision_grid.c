@@ -0,0 +1,146 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "collision_grid.h"
+
+void collision_grid_free(collision_grid *g) {
+	free(g->cell_start);
+	free(g->index);
+	free(g->cx);
+	free(g->cy);
+	free(g->cell_of);
+	memset(g, 0, sizeof(*g));
+}
+
+static bool reserve_entries(collision_grid *g, int capacity) {
+	if (capacity <= g->capacity)
+		return true;
+	free(g->index);
+	free(g->cx);
+	free(g->cy);
+	free(g->cell_of);
+	g->index = malloc(capacity * sizeof(int));
+	g->cx = malloc(capacity * sizeof(float));
+	g->cy = malloc(capacity * sizeof(float));
+	g->cell_of = malloc(capacity * sizeof(int));
+	g->capacity = g->index && g->cx && g->cy && g->cell_of ? capacity : 0;
+	return g->capacity;
+}
+
+static bool reserve_cells(collision_grid *g, int cells) {
+	if (cells + 1 <= g->cell_capacity)
+		return true;
+	free(g->cell_start);
+	g->cell_start = malloc((cells + 1) * sizeof(int));
+	g->cell_capacity = g->cell_start ? cells + 1 : 0;
+	return g->cell_capacity;
+}
+
+static inline int clamp_cell(float t, int cells) {
+	int c = (int)t;
+	return c < 0 ? 0 : c >= cells ? cells - 1 : c;
+}
+
+bool collision_grid_build(collision_grid *g, const sprite_store *store, const int *first, const int *count, int num_ranges) {
+	// Centres range over the arena plus half a sprite on every side
+	float m = store->margin;
+	g->left = -m;
+	g->top = -m;
+	g->cols = (int)ceilf((GSP_SCREEN_HEIGHT_TOP + 2.0f * m) / COLLISION_SIZE);
+	g->rows = (int)ceilf((GSP_SCREEN_WIDTH + 2.0f * m) / COLLISION_SIZE);
+	int cells = g->cols * g->rows;
+
+	int total = 0;
+	for (int r = 0; r < num_ranges; r++)
+		total += count[r];
+	if (!reserve_entries(g, total) || !reserve_cells(g, cells))
+		return false;
+	g->count = total;
+
+	// Count sprites per cell into the cell after it, so the running sum
+	// leaves start[c] at the first entry of cell c
+	int *start = g->cell_start;
+	memset(start, 0, (cells + 1) * sizeof(int));
+	int k = 0;
+	for (int r = 0; r < num_ranges; r++) {
+		for (int i = first[r]; i < first[r] + count[r]; i++, k++) {
+			float x = (store->x[i] + SPRITE_WIDTH / 2.0f - g->left) * (1.0f / COLLISION_SIZE);
+			float y = (store->y[i] + SPRITE_HEIGHT / 2.0f - g->top) * (1.0f / COLLISION_SIZE);
+			int c = clamp_cell(y, g->rows) * g->cols + clamp_cell(x, g->cols);
+			g->cell_of[k] = c;
+			start[c + 1]++;
+		}
+	}
+	for (int c = 0; c < cells; c++)
+		start[c + 1] += start[c];
+
+	// Fill each run in store order, using start[c] as its cursor. That
+	// leaves it at the start of the next cell, so shift them back after.
+	k = 0;
+	for (int r = 0; r < num_ranges; r++) {
+		for (int i = first[r]; i < first[r] + count[r]; i++, k++) {
+			int e = start[g->cell_of[k]]++;
+			g->index[e] = i;
+			g->cx[e] = store->x[i] + SPRITE_WIDTH / 2.0f;
+			g->cy[e] = store->y[i] + SPRITE_HEIGHT / 2.0f;
+		}
+	}
+	memmove(start + 1, start, cells * sizeof(int));
+	start[0] = 0;
+	return true;
+}
+
+// Bounce entries a and b apart if they overlap and approach each other
+static inline void collide_pair(collision_grid *g, sprite_store *store, int a, int b) {
+	float dx = g->cx[b] - g->cx[a];
+	float dy = g->cy[b] - g->cy[a];
+	float d2 = dx * dx + dy * dy;
+	g->tested++;
+	if (d2 >= COLLISION_SIZE * COLLISION_SIZE || d2 == 0.0f)
+		return;
+	g->overlaps++;
+
+	int i = g->index[a], j = g->index[b];
+	float dvx = store->velocity_x[i] - store->velocity_x[j];
+	float dvy = store->velocity_y[i] - store->velocity_y[j];
+	// Closing speed along the line between them, scaled by its length
+	float closing = dvx * dx + dvy * dy;
+	if (closing <= 0.0f)
+		return;
+	g->contacts++;
+
+	float s = closing / d2;
+	store->velocity_x[i] -= s * dx;
+	store->velocity_y[i] -= s * dy;
+	store->velocity_x[j] += s * dx;
+	store->velocity_y[j] += s * dy;
+}
+
+int collision_grid_collide(collision_grid *g, sprite_store *store) {
+	g->tested = 0;
+	g->overlaps = 0;
+	g->contacts = 0;
+	const int *start = g->cell_start;
+	for (int row = 0; row < g->rows; row++) {
+		for (int col = 0; col < g->cols; col++) {
+			int c = row * g->cols + col;
+			for (int a = start[c]; a < start[c + 1]; a++) {
+				// The rest of this cell, then the neighbours that come after
+				// it, so every pair is tested once
+				for (int b = a + 1; b < start[c + 1]; b++)
+					collide_pair(g, store, a, b);
+				if (col + 1 < g->cols)
+					for (int b = start[c + 1]; b < start[c + 2]; b++)
+						collide_pair(g, store, a, b);
+				if (row + 1 == g->rows)
+					continue;
+				int below = c + g->cols;
+				int from = start[col > 0 ? below - 1 : below];
+				int to = start[col + 1 < g->cols ? below + 2 : below + 1];
+				for (int b = from; b < to; b++)
+					collide_pair(g, store, a, b);
+			}
+		}
+	}
+	return g->contacts;
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dirty.h"
+
+bool dirty_init(dirty_set *set, int capacity) {
+	memset(set, 0, sizeof(*set));
+	return dirty_reserve(set, capacity);
+}
+
+void dirty_free(dirty_set *set) {
+	free(set->flags);
+	memset(set, 0, sizeof(*set));
+}
+
+bool dirty_reserve(dirty_set *set, int capacity) {
+	if (capacity <= set->capacity)
+		return true;
+	u8 *grown = realloc(set->flags, capacity);
+	if (!grown)
+		return false;
+	memset(grown + set->capacity, 0, capacity - set->capacity);
+	set->flags = grown;
+	set->capacity = capacity;
+	return true;
+}
+
+void dirty_mark(dirty_set *set, int first, int count) {
+	memset(set->flags + first, 1, count);
+}
+
+// Join the two neighbouring ranges with the fewest clean sprites between them
+static void merge_closest(dirty_set *set) {
+	int best = 0;
+	int best_gap = -1;
+	for (int i = 0; i + 1 < set->num_ranges; i++) {
+		int gap = set->ranges[i + 1].first - (set->ranges[i].first + set->ranges[i].count);
+		if (best_gap < 0 || gap < best_gap) {
+			best = i;
+			best_gap = gap;
+		}
+	}
+
+	dirty_range *a = &set->ranges[best];
+	const dirty_range *b = &set->ranges[best + 1];
+	a->count = b->first + b->count - a->first;
+	memmove(&set->ranges[best + 1], &set->ranges[best + 2], (set->num_ranges - best - 2) * sizeof(dirty_range));
+	set->num_ranges--;
+}
+
+// Append [first, first + count), merging into the previous range when the
+// gap is small
+static void add_range(dirty_set *set, int first, int count) {
+	if (set->num_ranges) {
+		dirty_range *last = &set->ranges[set->num_ranges - 1];
+		if (first - (last->first + last->count) < DIRTY_MERGE_GAP) {
+			last->count = first + count - last->first;
+			return;
+		}
+	}
+	if (set->num_ranges == DIRTY_MAX_RANGES)
+		merge_closest(set);
+	set->ranges[set->num_ranges++] = (dirty_range){first, count};
+}
+
+int dirty_collect(dirty_set *set, int count) {
+	set->num_ranges = 0;
+	if (count > set->capacity)
+		count = set->capacity;
+
+	const u8 *flags = set->flags;
+	for (int i = 0; i < count;) {
+		// Skip clean sprites a word at a time
+		while (i + 4 <= count && !((u32)flags[i] | flags[i + 1] | flags[i + 2] | flags[i + 3]))
+			i += 4;
+		while (i < count && !flags[i])
+			i++;
+		if (i == count)
+			break;
+
+		int first = i;
+		while (i < count && flags[i])
+			i++;
+		add_range(set, first, i - first);
+	}
+
+	if (set->num_ranges) {
+		const dirty_range *last = &set->ranges[set->num_ranges - 1];
+		memset(set->flags + set->ranges[0].first, 0, last->first + last->count - set->ranges[0].first);
+	}
+	return set->num_ranges;
+}
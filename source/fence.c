@@ -0,0 +1,73 @@
+#include "fence.h"
+
+// Frames whose start times are kept for the latency average; more than can
+// ever be in flight
+#define FENCE_HISTORY (8)
+
+static u32 submitted;
+static u32 completed;
+static u64 start_ticks[FENCE_HISTORY];
+static u64 latency_ticks[FENCE_HISTORY];
+static LightEvent finished;
+
+// Runs on the GSP event thread when the GPU finishes a command list. citro3d
+// submits exactly one per C3D_FrameEnd() and nothing else here submits any,
+// so lists finished and frames finished are the same count.
+static void frame_finished(void *param)
+{
+	(void)param;
+	u32 id = __atomic_add_fetch(&completed, 1, __ATOMIC_ACQ_REL);
+	latency_ticks[id % FENCE_HISTORY] = svcGetSystemTick() - start_ticks[id % FENCE_HISTORY];
+	LightEvent_Signal(&finished);
+}
+
+void fence_init(void)
+{
+	LightEvent_Init(&finished, RESET_ONESHOT);
+	gspSetEventCallback(GSPGPU_EVENT_P3D, frame_finished, NULL, false);
+}
+
+void fence_exit(void)
+{
+	fence_drain();
+	gspSetEventCallback(GSPGPU_EVENT_P3D, NULL, NULL, false);
+}
+
+u32 fence_submit(u64 start)
+{
+	u32 id = submitted + 1;
+	start_ticks[id % FENCE_HISTORY] = start;
+	__atomic_store_n(&submitted, id, __ATOMIC_RELEASE);
+	return id;
+}
+
+bool fence_done(u32 id)
+{
+	return (s32)(__atomic_load_n(&completed, __ATOMIC_ACQUIRE) - id) >= 0;
+}
+
+u64 fence_wait(u32 id)
+{
+	u64 start = svcGetSystemTick();
+	// The event may carry a stale signal, so always check the count again
+	while (!fence_done(id))
+		LightEvent_Wait(&finished);
+	return svcGetSystemTick() - start;
+}
+
+void fence_drain(void)
+{
+	fence_wait(submitted);
+}
+
+float fence_latency_ms(void)
+{
+	u64 total = 0;
+	int frames = 0;
+	u32 last = __atomic_load_n(&completed, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < FENCE_HISTORY / 2 && i < (int)last; i++) {
+		total += latency_ticks[(last - i) % FENCE_HISTORY];
+		frames++;
+	}
+	return frames ? total / CPU_TICKS_PER_MSEC / frames : 0.0f;
+}
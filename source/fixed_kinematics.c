@@ -0,0 +1,136 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fixed_kinematics.h"
+
+void fixed_kinematics_free(fixed_kinematics *k) {
+	free(k->position);
+	free(k->velocity);
+	memset(k, 0, sizeof(*k));
+}
+
+static bool reserve(fixed_kinematics *k, int capacity) {
+	if (capacity <= k->capacity)
+		return true;
+	free(k->position);
+	free(k->velocity);
+	k->position = malloc(capacity * sizeof(u32));
+	k->velocity = malloc(capacity * sizeof(u32));
+	k->capacity = k->position && k->velocity ? capacity : 0;
+	return k->capacity;
+}
+
+static inline u32 pack(int x, int y) {
+	return (u16)x | (u32)(u16)y << 16;
+}
+
+static inline s16 lane_x(u32 w) {
+	return (s16)w;
+}
+
+static inline s16 lane_y(u32 w) {
+	return (s16)(w >> 16);
+}
+
+// The arena's centre in pixels and its half size in steps. A position of p
+// steps is centre + (p + 0.5) / scale pixels, so the float bounce tests
+// x < low and x > high hold exactly when p < -half and p > half - 1.
+typedef struct {
+	float centre_x;
+	float centre_y;
+	int half_x;
+	int half_y;
+} arena;
+
+static arena arena_of(const sprite_store *store) {
+	float m = store->margin;
+	float width = (float)GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH, height = (float)GSP_SCREEN_WIDTH - SPRITE_HEIGHT;
+	return (arena){
+		width / 2.0f,
+		height / 2.0f,
+		(int)((width + 2.0f * m) * FIXED_KINEMATICS_SCALE / 2.0f),
+		(int)((height + 2.0f * m) * FIXED_KINEMATICS_SCALE / 2.0f),
+	};
+}
+
+// Exact in a float, so the store holds the same position as the copy
+static inline float to_pixels(int p, float centre) {
+	return ((float)p + 0.5f) * (1.0f / FIXED_KINEMATICS_SCALE) + centre;
+}
+
+bool fixed_kinematics_load(fixed_kinematics *k, sprite_store *store, int count) {
+	if (!reserve(k, count))
+		return false;
+	arena a = arena_of(store);
+	for (int i = 0; i < count; i++) {
+		int x = (int)floorf((store->x[i] - a.centre_x) * FIXED_KINEMATICS_SCALE);
+		int y = (int)floorf((store->y[i] - a.centre_y) * FIXED_KINEMATICS_SCALE);
+		int vx = (int)lrintf(store->velocity_x[i] * FIXED_KINEMATICS_SCALE);
+		int vy = (int)lrintf(store->velocity_y[i] * FIXED_KINEMATICS_SCALE);
+		k->position[i] = pack(x, y);
+		k->velocity[i] = pack(vx, vy);
+		store->x[i] = to_pixels(x, a.centre_x);
+		store->y[i] = to_pixels(y, a.centre_y);
+		store->velocity_x[i] = vx / FIXED_KINEMATICS_SCALE;
+		store->velocity_y[i] = vy / FIXED_KINEMATICS_SCALE;
+	}
+	return true;
+}
+
+int fixed_kinematics_ticks(fixed_kinematics *k, float delta) {
+	k->pending_ms += delta;
+	int ticks = (int)(k->pending_ms / FIXED_KINEMATICS_TICK_MS);
+	k->pending_ms -= ticks * FIXED_KINEMATICS_TICK_MS;
+	return ticks;
+}
+
+#ifdef __ARM_FEATURE_SIMD32
+// One packed add moves the sprite, then the velocity lanes whose position
+// left [low, high] are negated. Each compare is a packed subtract that sets
+// the GE flags of the lanes inside the edge, which SEL picks lanes by.
+static inline void step(u32 *p, u32 *v, u32 low, u32 high) {
+	u32 negated, scratch;
+	__asm__(
+		"sadd16 %[p], %[p], %[v]\n\t"
+		"ssub16 %[n], %[zero], %[v]\n\t"
+		"ssub16 %[t], %[p], %[low]\n\t"
+		"sel %[v], %[v], %[n]\n\t"
+		"ssub16 %[n], %[zero], %[v]\n\t"
+		"ssub16 %[t], %[high], %[p]\n\t"
+		"sel %[v], %[v], %[n]"
+		: [p] "+r" (*p), [v] "+r" (*v), [n] "=&r" (negated), [t] "=&r" (scratch)
+		: [low] "r" (low), [high] "r" (high), [zero] "r" (0)
+		: "cc");
+}
+#else
+// The same a lane at a time, wrapping like SADD16
+static inline void step(u32 *p, u32 *v, u32 low, u32 high) {
+	int x = (s16)(lane_x(*p) + lane_x(*v)), y = (s16)(lane_y(*p) + lane_y(*v));
+	int vx = lane_x(*v), vy = lane_y(*v);
+	vx = (x < lane_x(low)) | (x > lane_x(high)) ? -vx : vx;
+	vy = (y < lane_y(low)) | (y > lane_y(high)) ? -vy : vy;
+	*p = pack(x, y);
+	*v = pack(vx, vy);
+}
+#endif
+
+void fixed_kinematics_update(fixed_kinematics *k, sprite_store *store, int first, int count, int ticks) {
+	if (!ticks)
+		return;
+	arena a = arena_of(store);
+	u32 low = pack(-a.half_x, -a.half_y), high = pack(a.half_x - 1, a.half_y - 1);
+	for (int i = first; i < first + count; i++) {
+		u32 p = k->position[i], v = k->velocity[i], before = v;
+		for (int t = 0; t < ticks; t++)
+			step(&p, &v, low, high);
+		k->position[i] = p;
+		k->velocity[i] = v;
+		store->x[i] = to_pixels(lane_x(p), a.centre_x);
+		store->y[i] = to_pixels(lane_y(p), a.centre_y);
+		// Bounces only flip signs, so the store's velocities rarely change
+		if (v != before) {
+			store->velocity_x[i] = lane_x(v) / FIXED_KINEMATICS_SCALE;
+			store->velocity_y[i] = lane_y(v) / FIXED_KINEMATICS_SCALE;
+		}
+	}
+}
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include "flecs.h"
+#include "flecs_os.h"
+
+#ifdef __3DS__
+#include <3ds.h>
+#include "jobs.h"
+
+#define FLECS_STACK_SIZE (16 * 1024)
+
+// flecs threads return a value, libctru ones do not
+typedef struct {
+	Thread thread;
+	ecs_os_thread_callback_t callback;
+	void *param;
+	void *result;
+} flecs_thread;
+
+// Workers flecs started so far, which picks their cores
+static int started;
+
+static void thread_entry(void *arg) {
+	flecs_thread *t = arg;
+	t->result = t->callback(t->param);
+}
+
+static ecs_os_thread_t thread_new(ecs_os_thread_callback_t callback, void *param) {
+	flecs_thread *t = malloc(sizeof(*t));
+	if (!t)
+		return 0;
+	*t = (flecs_thread){NULL, callback, param, NULL};
+	t->thread = jobs_start_thread(thread_entry, t, FLECS_STACK_SIZE, started++);
+	if (!t->thread) {
+		free(t);
+		return 0;
+	}
+	return (ecs_os_thread_t)t;
+}
+
+static void *thread_join(ecs_os_thread_t thread) {
+	flecs_thread *t = (flecs_thread *)thread;
+	threadJoin(t->thread, U64_MAX);
+	threadFree(t->thread);
+	void *result = t->result;
+	free(t);
+	started--;
+	return result;
+}
+
+static ecs_os_thread_id_t thread_self(void) {
+	return (ecs_os_thread_id_t)(uintptr_t)threadGetCurrent();
+}
+
+static ecs_os_mutex_t mutex_new(void) {
+	LightLock *lock = malloc(sizeof(*lock));
+	if (lock)
+		LightLock_Init(lock);
+	return (ecs_os_mutex_t)lock;
+}
+
+static void mutex_free(ecs_os_mutex_t mutex) { free((LightLock *)mutex); }
+static void mutex_lock(ecs_os_mutex_t mutex) { LightLock_Lock((LightLock *)mutex); }
+static void mutex_unlock(ecs_os_mutex_t mutex) { LightLock_Unlock((LightLock *)mutex); }
+
+static ecs_os_cond_t cond_new(void) {
+	CondVar *cond = malloc(sizeof(*cond));
+	if (cond)
+		CondVar_Init(cond);
+	return (ecs_os_cond_t)cond;
+}
+
+static void cond_free(ecs_os_cond_t cond) { free((CondVar *)cond); }
+static void cond_signal(ecs_os_cond_t cond) { CondVar_Signal((CondVar *)cond); }
+static void cond_broadcast(ecs_os_cond_t cond) { CondVar_Broadcast((CondVar *)cond); }
+static void cond_wait(ecs_os_cond_t cond, ecs_os_mutex_t mutex) { CondVar_Wait((CondVar *)cond, (LightLock *)mutex); }
+
+static void sleep_for(int32_t sec, int32_t nanosec) {
+	svcSleepThread(sec * 1000000000LL + nanosec);
+}
+
+static uint64_t now(void) {
+	// The tick counter wraps after a couple of thousand years
+	u64 ticks = svcGetSystemTick();
+	return ticks / SYSCLOCK_ARM11 * 1000000000ULL + ticks % SYSCLOCK_ARM11 * 1000000000ULL / SYSCLOCK_ARM11;
+}
+#else
+#include <pthread.h>
+#include <time.h>
+
+static ecs_os_thread_t thread_new(ecs_os_thread_callback_t callback, void *param) {
+	pthread_t *thread = malloc(sizeof(*thread));
+	if (!thread)
+		return 0;
+	if (pthread_create(thread, NULL, callback, param)) {
+		free(thread);
+		return 0;
+	}
+	return (ecs_os_thread_t)thread;
+}
+
+static void *thread_join(ecs_os_thread_t thread) {
+	pthread_t *t = (pthread_t *)thread;
+	void *result = NULL;
+	pthread_join(*t, &result);
+	free(t);
+	return result;
+}
+
+static ecs_os_thread_id_t thread_self(void) {
+	return (ecs_os_thread_id_t)pthread_self();
+}
+
+static ecs_os_mutex_t mutex_new(void) {
+	pthread_mutex_t *mutex = malloc(sizeof(*mutex));
+	if (mutex)
+		pthread_mutex_init(mutex, NULL);
+	return (ecs_os_mutex_t)mutex;
+}
+
+static void mutex_free(ecs_os_mutex_t mutex) {
+	pthread_mutex_destroy((pthread_mutex_t *)mutex);
+	free((pthread_mutex_t *)mutex);
+}
+
+static void mutex_lock(ecs_os_mutex_t mutex) { pthread_mutex_lock((pthread_mutex_t *)mutex); }
+static void mutex_unlock(ecs_os_mutex_t mutex) { pthread_mutex_unlock((pthread_mutex_t *)mutex); }
+
+static ecs_os_cond_t cond_new(void) {
+	pthread_cond_t *cond = malloc(sizeof(*cond));
+	if (cond)
+		pthread_cond_init(cond, NULL);
+	return (ecs_os_cond_t)cond;
+}
+
+static void cond_free(ecs_os_cond_t cond) {
+	pthread_cond_destroy((pthread_cond_t *)cond);
+	free((pthread_cond_t *)cond);
+}
+
+static void cond_signal(ecs_os_cond_t cond) { pthread_cond_signal((pthread_cond_t *)cond); }
+static void cond_broadcast(ecs_os_cond_t cond) { pthread_cond_broadcast((pthread_cond_t *)cond); }
+static void cond_wait(ecs_os_cond_t cond, ecs_os_mutex_t mutex) {
+	pthread_cond_wait((pthread_cond_t *)cond, (pthread_mutex_t *)mutex);
+}
+
+static void sleep_for(int32_t sec, int32_t nanosec) {
+	struct timespec t = {sec, nanosec};
+	nanosleep(&t, NULL);
+}
+
+static uint64_t now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+#endif
+
+static int32_t atomic_inc(int32_t *value) { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+static int32_t atomic_dec(int32_t *value) { return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST); }
+static int64_t atomic_inc64(int64_t *value) { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+static int64_t atomic_dec64(int64_t *value) { return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST); }
+
+static void get_time(ecs_time_t *time) {
+	uint64_t ns = now();
+	time->sec = (uint32_t)(ns / 1000000000ULL);
+	time->nanosec = (uint32_t)(ns % 1000000000ULL);
+}
+
+void flecs_os_init(void) {
+	ecs_os_set_api_defaults();
+	ecs_os_api_t api = ecs_os_api;
+	api.thread_new_ = thread_new;
+	api.thread_join_ = thread_join;
+	api.thread_self_ = thread_self;
+	api.ainc_ = atomic_inc;
+	api.adec_ = atomic_dec;
+	api.lainc_ = atomic_inc64;
+	api.ladec_ = atomic_dec64;
+	api.mutex_new_ = mutex_new;
+	api.mutex_free_ = mutex_free;
+	api.mutex_lock_ = mutex_lock;
+	api.mutex_unlock_ = mutex_unlock;
+	api.cond_new_ = cond_new;
+	api.cond_free_ = cond_free;
+	api.cond_signal_ = cond_signal;
+	api.cond_broadcast_ = cond_broadcast;
+	api.cond_wait_ = cond_wait;
+	api.sleep_ = sleep_for;
+	api.now_ = now;
+	api.get_time_ = get_time;
+	ecs_os_set_api(&api);
+}
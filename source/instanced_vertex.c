@@ -0,0 +1,41 @@
+#include "instanced_vertex.h"
+
+void instanced_quads(instanced_vertex *dest) {
+	for (int i = 0; i < INSTANCED_BATCH * SPRITE_QUAD_VERTICES; i++) {
+		int corner = i % SPRITE_QUAD_VERTICES;
+		dest[i].slot = i / SPRITE_QUAD_VERTICES;
+		dest[i].corner_x = corner & 1;
+		dest[i].corner_y = corner >> 1;
+		dest[i].pad = 0;
+	}
+}
+
+void move_instance(sprite_instance *dest, float x, float y, float z) {
+	dest->x = x;
+	dest->y = y;
+	dest->z = z;
+}
+
+void add_instance(sprite_instance *dest, float x, float y, float z, int entry) {
+	move_instance(dest, x, y, z);
+	dest->entry = entry;
+}
+
+void sprite_store_emit_instances(const sprite_store *store, sprite_instance *instances, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_instance(&instances[i], store->x[i], store->y[i], store->z[i]);
+}
+
+vertex instanced_vertex_at(const instanced_vertex *p, const sprite_instance *batch, const uvlut_table *table,
+	float width, float height) {
+	const sprite_instance *s = &batch[p->slot];
+	const float *rect = table->rect[(int)s->entry];
+	vertex v = {
+		s->x + width * p->corner_x,
+		s->y + height * p->corner_y,
+		s->z,
+		rect[0] + (rect[2] - rect[0]) * p->corner_x,
+		rect[1] + (rect[3] - rect[1]) * p->corner_y,
+	};
+	return v;
+}
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include "jobs.h"
+#include "profile.h"
+
+#ifdef __3DS__
+#include <3ds.h>
+
+#define WORKER_STACK_SIZE (16 * 1024)
+
+typedef Thread job_thread;
+typedef LightEvent job_event;
+
+static void event_init(job_event *event) { LightEvent_Init(event, RESET_ONESHOT); }
+static void event_destroy(job_event *event) { (void)event; }
+static void event_signal(job_event *event) { LightEvent_Signal(event); }
+static void event_wait(job_event *event) { LightEvent_Wait(event); }
+#else
+#include <pthread.h>
+
+typedef pthread_t job_thread;
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool set;
+} job_event;
+
+static void event_init(job_event *event) {
+	pthread_mutex_init(&event->lock, NULL);
+	pthread_cond_init(&event->cond, NULL);
+	event->set = false;
+}
+
+static void event_destroy(job_event *event) {
+	pthread_cond_destroy(&event->cond);
+	pthread_mutex_destroy(&event->lock);
+}
+
+static void event_signal(job_event *event) {
+	pthread_mutex_lock(&event->lock);
+	event->set = true;
+	pthread_cond_signal(&event->cond);
+	pthread_mutex_unlock(&event->lock);
+}
+
+// Auto-resetting, like a RESET_ONESHOT LightEvent
+static void event_wait(job_event *event) {
+	pthread_mutex_lock(&event->lock);
+	while (!event->set)
+		pthread_cond_wait(&event->cond, &event->lock);
+	event->set = false;
+	pthread_mutex_unlock(&event->lock);
+}
+#endif
+
+typedef struct {
+	job_system *js;
+	job_thread thread;
+	job_event start;
+} job_worker;
+
+struct job_system {
+	int num_workers;
+	job_worker workers[JOBS_MAX_THREADS - 1];
+	job_event done;
+	bool quit;
+
+	// The job in flight
+	job_func func;
+	void *ctx;
+	int count;
+	int chunk;
+	int next;
+	int active;
+};
+
+// Claim and run chunks until the range is exhausted
+static void run_chunks(job_system *js) {
+	for (;;) {
+		int first = __atomic_fetch_add(&js->next, js->chunk, __ATOMIC_RELAXED);
+		if (first >= js->count)
+			break;
+		int count = js->count - first < js->chunk ? js->count - first : js->chunk;
+		PROFILE_ZONE("job chunk");
+		js->func(js->ctx, first, count);
+	}
+}
+
+// The last thread out wakes up jobs_run()
+static void finish(job_system *js) {
+	if (__atomic_sub_fetch(&js->active, 1, __ATOMIC_ACQ_REL) == 0)
+		event_signal(&js->done);
+}
+
+static void worker_main(job_worker *w) {
+	job_system *js = w->js;
+	for (;;) {
+		event_wait(&w->start);
+		if (js->quit)
+			break;
+		run_chunks(js);
+		finish(js);
+	}
+}
+
+#ifdef __3DS__
+static void worker_entry(void *arg) {
+	worker_main(arg);
+}
+
+Thread jobs_start_thread(ThreadFunc entry, void *arg, size_t stack_size, int index) {
+	s32 priority = 0x30;
+	svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+
+	// Prefer the New 3DS' spare app core, then the system core
+	bool is_new3ds = false;
+	APT_CheckNew3DS(&is_new3ds);
+	static const int new3ds_cores[] = {2, 1};
+	static const int old3ds_cores[] = {1};
+	const int *cores = is_new3ds ? new3ds_cores : old3ds_cores;
+	int num_cores = is_new3ds ? 2 : 1;
+	int core = index < num_cores ? cores[index] : -2;
+
+	// The app may only use part of the system core's time
+	if (core == 1)
+		APT_SetAppCpuTimeLimit(80);
+
+	Thread thread = threadCreate(entry, arg, stack_size, priority - 1, core, false);
+	if (!thread && core != -2)
+		thread = threadCreate(entry, arg, stack_size, priority - 1, -2, false);
+	return thread;
+}
+
+static bool worker_start(job_worker *w, int index) {
+	w->thread = jobs_start_thread(worker_entry, w, WORKER_STACK_SIZE, index);
+	return w->thread != NULL;
+}
+
+static void worker_join(job_worker *w) {
+	threadJoin(w->thread, U64_MAX);
+	threadFree(w->thread);
+}
+#else
+static void *worker_entry(void *arg) {
+	worker_main(arg);
+	return NULL;
+}
+
+static bool worker_start(job_worker *w, int index) {
+	(void)index;
+	return pthread_create(&w->thread, NULL, worker_entry, w) == 0;
+}
+
+static void worker_join(job_worker *w) {
+	pthread_join(w->thread, NULL);
+}
+#endif
+
+job_system *jobs_create(int threads) {
+	if (threads < 1)
+		threads = 1;
+	if (threads > JOBS_MAX_THREADS)
+		threads = JOBS_MAX_THREADS;
+
+	job_system *js = calloc(1, sizeof(job_system));
+	if (!js)
+		return NULL;
+	event_init(&js->done);
+
+	for (int i = 0; i < threads - 1; i++) {
+		job_worker *w = &js->workers[i];
+		w->js = js;
+		event_init(&w->start);
+		if (!worker_start(w, i)) {
+			event_destroy(&w->start);
+			break;
+		}
+		js->num_workers++;
+	}
+	return js;
+}
+
+void jobs_destroy(job_system *js) {
+	js->quit = true;
+	for (int i = 0; i < js->num_workers; i++) {
+		event_signal(&js->workers[i].start);
+		worker_join(&js->workers[i]);
+		event_destroy(&js->workers[i].start);
+	}
+	event_destroy(&js->done);
+	free(js);
+}
+
+int jobs_threads(const job_system *js) {
+	return js->num_workers + 1;
+}
+
+void jobs_run(job_system *js, int threads, job_func func, void *ctx, int count, int min_chunk) {
+	int workers = threads - 1;
+	if (workers > js->num_workers)
+		workers = js->num_workers;
+	if (workers < 0)
+		workers = 0;
+
+	// A few chunks per thread evens out uneven cores
+	int chunk = count / ((workers + 1) * 4);
+	if (chunk < min_chunk)
+		chunk = min_chunk;
+	if (chunk < 1)
+		chunk = 1;
+
+	// Not worth waking anyone for a single chunk
+	if (!workers || count <= chunk) {
+		if (count > 0)
+			func(ctx, 0, count);
+		return;
+	}
+
+	js->func = func;
+	js->ctx = ctx;
+	js->count = count;
+	js->chunk = chunk;
+	js->next = 0;
+	js->active = workers + 1;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (int i = 0; i < workers; i++)
+		event_signal(&js->workers[i].start);
+
+	run_chunks(js);
+	finish(js);
+	event_wait(&js->done);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
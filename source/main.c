@@ -4,7 +4,21 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/time.h>
-#include "vshader_shbin.h"
+#include "sprites.h"
+#include "sprite_store.h"
+#include "render.h"
+#include "jobs.h"
+#include "cmdlist.h"
+#include "profile.h"
+#include "bench_script.h"
+#include "dirty.h"
+#include "fence.h"
+#include "atlas_buckets.h"
+#include "sprite_order.h"
+#include "collision_grid.h"
+#include "sprite_world.h"
+#include "fixed_kinematics.h"
+#include "analytic_vertex.h"
 #include "emotes110_t3x.h"
 #include "emotes64_t3x.h"
 
@@ -30,35 +44,163 @@ const int CLEAR_COLOR = 0x0437F2FF;
 	 GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGBA8) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB8) | \
 	 GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
 
-typedef struct {float x; float y; float z; float u; float v;} vertex;
-typedef struct {float x; float y; float z; float velocity_x; float velocity_y; size_t t3x_index;} spriteinfo;
-
-static DVLB_s *vshader_dvlb;
-static shaderProgram_s program;
-static int uLoc_projection;
-static int uLoc_tint;
-static int uLoc_depthinfo;
 static C3D_Mtx projection;
 
-static vertex *vbo_data;
+static const render_path *const paths[] = {&path_arrays, &path_indexed, &path_points, &path_packed, &path_analytic, &path_uvlut, &path_split, &path_instanced};
+#define NUM_PATHS (sizeof(paths) / sizeof(paths[0]))
+static int current_path = 0;
+
+// Bytes of vertex data written this frame
+static size_t vbo_bytes;
+
+// How each eye's draw reaches the command buffer
+enum {
+	SUBMIT_REDRAW, // run sceneRender() through citro3d for both eyes
+	SUBMIT_REPLAY, // replay the right eye's recorded commands
+	SUBMIT_CACHED, // replay both eyes' recorded commands
+	NUM_SUBMIT_MODES,
+};
+static int submit_mode = SUBMIT_CACHED;
+
+// One eye's draw as citro3d emitted it, with the words that change between
+// frames located so they can be rewritten in place
+typedef struct {
+	cmdlist commands;
+	cmdlist_patch parallax;
+	// One word per draw, in bucket order
+	cmdlist_patch vertices;
+	// Buckets that had sprites to draw when it was recorded
+	u32 buckets;
+	bool valid;
+} recorded_eye;
+// Recorded per ring slot, since each slot's draw points at its own buffer
+static recorded_eye eyes[VBO_RING_MAX][2];
+
+// Last frame's cost in each mode, for comparison on the HUD
+static float submit_cpu[NUM_SUBMIT_MODES];
+static float submit_cmdbuf[NUM_SUBMIT_MODES];
+static u32 submit_bytes[NUM_SUBMIT_MODES];
+
+// Threads the sprite update is split across, the main thread included
+static job_system *jobs;
+static int update_threads = 1;
+
+// Every sprite draws from one of these; sprites are bucketed by atlas and
+// each bucket is one texture bind and one draw
+enum {
+	ATLAS_110,
+	ATLAS_64,
+	NUM_ATLASES,
+};
+static C3D_Tex textures[NUM_ATLASES];
+static Tex3DS_Texture atlases[NUM_ATLASES];
+
+// How sprites pick their atlas: the first modes put every sprite on the atlas
+// of the same number
+enum {
+	ATLAS_MODE_110 = ATLAS_110,
+	ATLAS_MODE_64 = ATLAS_64,
+	ATLAS_MODE_MIXED,
+	NUM_ATLAS_MODES,
+};
+static int atlas_mode = ATLAS_MODE_110;
+static atlas_buckets buckets;
+// Draw calls issued or replayed this frame
+static int frame_draws;
 
-static bool largetex = true;
+// With culling on, only the sprites on screen are written, packed together
+// at the start of their bucket, so sprites that wander off screen cost no
+// vertex writes and no GPU time
+static int culling = 0;
+// The sprites gathered for the vertex writers when culling or sorting, at
+// their packed indices
+static sprite_store view;
+// Sprites drawn from each bucket this frame
+static int drawn[NUM_ATLASES];
+// Sprites roam an arena this many screens wide, centred on the top screen
+static int arena = 1;
 
-static C3D_Tex texture_110;
-static Tex3DS_Texture t3x_110;
-static C3D_Tex texture_64;
-static Tex3DS_Texture t3x_64;
+// Gather each bucket in the order of a key: front to back, so the depth test
+// rejects most of what is hidden before it is shaded, or top to bottom. The
+// order is kept from frame to frame and only repaired.
+enum {
+	ORDER_OFF,
+	ORDER_DEPTH,
+	ORDER_ROWS,
+	NUM_ORDERS,
+};
+static const sprite_order_key *const order_keys[NUM_ORDERS] = {NULL, &sprite_order_depth, &sprite_order_rows};
+static int sort_order = ORDER_OFF;
+static sprite_order order = {.key = &sprite_order_depth};
+// Use the GPU's early depth test on top of the regular one
+static int early_depth = 0;
 
-#define MAX_SPRITES (1500)
-#define SPRITE_HEIGHT (64.0f)
-#define SPRITE_WIDTH (64.0f)
-#define MIN_DEPTH (-25.0f)
-#define MAX_DEPTH (10.0f)
-#define DEEPNESS (MAX_DEPTH - MIN_DEPTH)
+// Bounce shown sprites off each other, paired through a grid rebuilt every
+// frame
+static int colliding = 0;
+static collision_grid grid;
 
+// Run the sprite update as flecs systems instead of update jobs, or as
+// update jobs on packed 16-bit fixed-point positions, to compare the three.
+// The world and the fixed-point copy keep their own copy of the shown
+// sprites and save it back to the store every step, so everything else keeps
+// using the store.
+enum {
+	SIM_STORE,
+	SIM_FLECS,
+	SIM_FIXED,
+	NUM_SIMS,
+};
+static int simulation = SIM_STORE;
+static sprite_world world;
+static fixed_kinematics fixed;
+
+// The analytic path bounces the sprites in its vertex shader, so while
+// nothing else needs their positions the store stays where the vertices were
+// written and only the clock moves on. The store catches up whenever
+// something does need them, or the clock has run for too long.
+static bool analytic_moving;
+static float analytic_ticks;
+// Set when the store changed under the world or the fixed-point copy, which
+// reload it before the next step
+static bool sim_stale = true;
 
 static int current_sprites = 1;
-static spriteinfo sprites[MAX_SPRITES];
+static sprite_store sprites;
+
+// Sprites whose vertices were written since the last flush. The GPU only
+// sees these ranges flushed, not the whole linear heap.
+static dirty_set dirty;
+// Bytes of vertex buffer the frame dirtied in the cache and flushed out of it
+static size_t flush_bytes;
+static int flush_ranges;
+
+// Vertex buffers the current path cycles through. With one the CPU waits
+// for the GPU to finish the last frame before writing; with more it fills
+// the next buffer while the GPU still reads the previous one.
+static int ring_slots = 2;
+static int current_slot = 0;
+
+// What a ring slot's buffer holds: whether it is stale, how many texcoords
+// are valid, the simulation step of its positions, and the fence of the last
+// frame that read it. Writes only reach the selected slot, so the others
+// catch up when their turn comes.
+typedef struct {
+	// The pool, path or scene changed under it and it needs a full rebuild
+	bool stale;
+	// The first uv_valid[i] sprites of bucket i have texture coordinates
+	// for its atlas; the rest are rewritten when they come into view
+	int uv_valid[NUM_ATLASES];
+	// Simulation step its positions were written at
+	u32 sim_step;
+	// Last frame that read it
+	u32 fence;
+} ring_slot;
+static ring_slot slots[VBO_RING_MAX];
+static u32 sim_step;
+// Time this frame spent waiting for its slot; the latency from input to the
+// GPU finishing is kept by fence.c
+static float fence_wait_ms;
 
 // Helper function for loading a texture from memory
 static bool loadTextureFromMem(C3D_Tex *tex, Tex3DS_Texture *t3x, C3D_TexCube *cube, const void *data, size_t size)
@@ -70,113 +212,84 @@ static bool loadTextureFromMem(C3D_Tex *tex, Tex3DS_Texture *t3x, C3D_TexCube *c
 	return true;
 }
 
-float randbetween(float min, float max) {
-	return (float)rand() / RAND_MAX * (max - min) + min;
-}
-
-void add_rect(vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts) {
-	vertex vertex_list[] = {
-		{x, y, z, ts->left, ts->top},
-		{x + width, y, z, ts->right, ts->top},
-		{x, y + height, z, ts->left, ts->bottom},
-		{x, y + height, z, ts->left, ts->bottom},
-		{x + width, y, z, ts->right, ts->top},
-		{x + width, y + height, z, ts->right, ts->bottom},
-	};
-
-	memcpy(dest, vertex_list, sizeof(vertex_list));
-}
-
-void move_rect(vertex *dest, float x, float y, float z, float width, float height) {
-	dest[0].x = x;
-	dest[0].y = y;
-	dest[0].z = z;
-	dest[1].x = x + width;
-	dest[1].y = y;
-	dest[1].z = z;
-	dest[2].x = x;
-	dest[2].y = y + height;
-	dest[2].z = z;
-	dest[3].x = x;
-	dest[3].y = y + height;
-	dest[3].z = z;
-	dest[4].x = x + width;
-	dest[4].y = y;
-	dest[4].z = z;
-	dest[5].x = x + width;
-	dest[5].y = y + height;
-	dest[5].z = z;
-}
-
-void uv_rect(vertex *dest, const Tex3DS_SubTexture *ts) {
-	dest[0].u = ts->left;
-	dest[0].v = ts->top;
-	dest[1].u = ts->right;
-	dest[1].v = ts->top;
-	dest[2].u = ts->left;
-	dest[2].v = ts->bottom;
-	dest[3].u = ts->left;
-	dest[3].v = ts->bottom;
-	dest[4].u = ts->right;
-	dest[4].v = ts->top;
-	dest[5].u = ts->right;
-	dest[5].v = ts->bottom;
+static u8 pickAtlas(void)
+{
+	return atlas_mode == ATLAS_MODE_MIXED ? rand() % NUM_ATLASES : atlas_mode;
 }
 
-static void sceneInit(void)
+// Scatter sprites [first, first + count) from the current rand() state. Both
+// atlases hold the same emotes, so any entry is valid in either. Atlases are
+// picked in a pass of their own, so the same seed scatters the same scene
+// whichever atlas mode draws from rand() too.
+static void randomizeSprites(int first, int count)
 {
-	// Load the vertex shader, create a shader program and bind it
-	vshader_dvlb = DVLB_ParseFile((u32 *)vshader_shbin, vshader_shbin_size);
-	shaderProgramInit(&program);
-	shaderProgramSetVsh(&program, &vshader_dvlb->DVLE[0]);
-	C3D_BindProgram(&program);
+	for (int i = first; i < first + count; i++) {
+		spriteinfo s = sprite_random(Tex3DS_GetNumSubTextures(atlases[ATLAS_110]));
+		sprite_store_set(&sprites, i, &s);
+	}
+	for (int i = first; i < first + count; i++)
+		sprites.atlas[i] = pickAtlas();
+}
 
-	// Get the location of the uniforms
-	uLoc_projection = shaderInstanceGetUniformLocation(program.vertexShader, "projection");
-	uLoc_tint = shaderInstanceGetUniformLocation(program.vertexShader, "tint");
-	uLoc_depthinfo = shaderInstanceGetUniformLocation(program.vertexShader, "depthinfo");
+// Bucket sprites [sorted, count) by atlas along with the ones before them,
+// and merge them into the order of their buckets. False if out of memory.
+static bool sortSprites(int sorted, int count)
+{
+	int old_first[NUM_ATLASES], old_size[NUM_ATLASES];
+	memcpy(old_first, buckets.first, sizeof(old_first));
+	memcpy(old_size, buckets.size, sizeof(old_size));
+	if (!sprite_order_reserve(&order, count) || !atlas_buckets_sort(&buckets, &sprites, sorted, count, NUM_ATLASES))
+		return false;
 
-	// Configure attributes for use with the vertex shader
-	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
-	AttrInfo_Init(attrInfo);
-	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=position
-	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 2);
+	PROFILE_ZONE("order");
+	for (int i = NUM_ATLASES - 1; i >= 0; i--) {
+		// Growing only moves buckets up the pool, so the last goes first
+		if (sorted)
+			sprite_order_grow(&order, &sprites, old_first[i], old_size[i], buckets.first[i], buckets.size[i]);
+		else
+			sprite_order_sort(&order, &sprites, buckets.first[i], buckets.size[i]);
+	}
+	return true;
+}
 
+static void sceneInit(void)
+{
 	// Compute the projection matrix
 	Mtx_OrthoTilt(&projection, 0, 400.0, 240, 0, 1000.0, -1000.0, true);
+	render_set_projection(&projection);
 
-	// Load the texture and bind it to the first texture unit
-	if (!loadTextureFromMem(&texture_110, &t3x_110, NULL, emotes110_t3x, emotes110_t3x_size))
+	// Load the textures; each bucket binds its own to the first texture unit
+	if (!loadTextureFromMem(&textures[ATLAS_110], &atlases[ATLAS_110], NULL, emotes110_t3x, emotes110_t3x_size))
 		svcBreak(USERBREAK_PANIC);
 		
-	if (!loadTextureFromMem(&texture_64, &t3x_64, NULL, emotes64_t3x, emotes64_t3x_size))
+	if (!loadTextureFromMem(&textures[ATLAS_64], &atlases[ATLAS_64], NULL, emotes64_t3x, emotes64_t3x_size))
 		svcBreak(USERBREAK_PANIC);
 
-	// Create the VBO (vertex buffer object)
-	vbo_data = linearAlloc(MAX_SPRITES * 6 * sizeof(vertex));
-
-	for (int i = 0; i < MAX_SPRITES; i++) {
-		float width = 400 - SPRITE_WIDTH;
-		float height = 240 - SPRITE_HEIGHT;
+	if (!sprite_store_init(&sprites, DEFAULT_SPRITES) || !sprite_store_init(&view, DEFAULT_SPRITES) ||
+		!sprite_world_init(&world))
+		svcBreak(USERBREAK_PANIC);
 
-		spriteinfo s =  {randbetween(0, width), randbetween(0, height), randbetween(MIN_DEPTH, MAX_DEPTH), randbetween(-2, 2), randbetween(-2, 2),  randbetween(0, Tex3DS_GetNumSubTextures(t3x_110))};
-		sprites[i] = s;
-		
-		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(largetex ? t3x_110 : t3x_64, s.t3x_index);
+	randomizeSprites(0, sprites.capacity);
+	if (!dirty_init(&dirty, sprites.capacity) || !sortSprites(0, sprites.capacity))
+		svcBreak(USERBREAK_PANIC);
 
-		// add_rect(&vbo_data[i * 6], s.x, s.y, MIN_DEPTH + (float)(i + 1) / (float)MAX_SPRITES * DEEPNESS, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
-		add_rect(&vbo_data[i * 6], s.x, s.y, s.z, SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+	// Every path keeps its own vertex buffers. They start at the pool's size
+	// with a single slot; only the current one follows the pool and the ring
+	// size, the others catch up when switched to.
+	for (size_t i = 0; i < NUM_PATHS; i++) {
+		if (!paths[i]->init(sprites.capacity))
+			svcBreak(USERBREAK_PANIC);
 	}
-
-	// Configure buffers
-	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
-	BufInfo_Init(bufInfo);
-	BufInfo_Add(bufInfo, vbo_data, sizeof(vertex), 2, 0x10);
+	if (!paths[current_path]->reserve(sprites.capacity, ring_slots))
+		svcBreak(USERBREAK_PANIC);
+	paths[current_path]->bind();
+	// Filled in by the first frame that selects each slot
+	for (int i = 0; i < VBO_RING_MAX; i++)
+		slots[i].stale = true;
 
 	// C3D_TexSetWrap(&texture, GPU_REPEAT, GPU_REPEAT);
-	C3D_TexSetFilter(&texture_110, GPU_LINEAR, GPU_NEAREST);
-	C3D_TexSetFilter(&texture_64, GPU_LINEAR, GPU_NEAREST);
-	C3D_TexBind(0, &texture_110);
+	for (int i = 0; i < NUM_ATLASES; i++)
+		C3D_TexSetFilter(&textures[i], GPU_LINEAR, GPU_NEAREST);
 	// Configure the first fragment shading substage to blend the texture color with
 	// the vertex color (calculated by the vertex shader using a lighting algorithm)
 	// See https://www.opengl.org/sdk/docs/man2/xhtml/glTexEnv.xml for more insight
@@ -186,53 +299,585 @@ static void sceneInit(void)
 	C3D_TexEnvFunc(env, C3D_Both, GPU_MODULATE);
 
 	C3D_AlphaTest(true, GPU_EQUAL, 255);
+	// citro3d's default, spelled out since the front-to-back order relies on
+	// it: the projection puts larger z nearer, and nearer passes GREATER
+	C3D_DepthTest(true, GPU_GREATER, GPU_WRITE_ALL);
 
 	C3D_CullFace(GPU_CULL_NONE);
 }
 
-static void update(float delta) {
-	delta *= 6.0 / 100.0;
-	for (int i = 0; i < current_sprites; i++) {
-		spriteinfo *s = &sprites[i];
-		s->x += s->velocity_x * delta;
-		s->y += s->velocity_y * delta;
+// Draw each bucket with its atlas bound. Returns the number of draw calls.
+static int sceneRender(float iod)
+{
+	int draws = 0;
+	for (int i = 0; i < NUM_ATLASES; i++) {
+		if (!drawn[i])
+			continue;
+		C3D_TexBind(0, &textures[i]);
+		if (paths[current_path] == &path_uvlut)
+			path_uvlut_atlas(atlases[i]);
+		else if (paths[current_path] == &path_instanced)
+			path_instanced_atlas(atlases[i]);
+		draws += paths[current_path]->draw(buckets.first[i], drawn[i], iod);
+	}
+	frame_draws += draws;
+	return draws;
+}
+
+// Buckets with sprites to draw, as a mask
+static u32 drawnBuckets(void)
+{
+	u32 mask = 0;
+	for (int i = 0; i < NUM_ATLASES; i++)
+		mask |= (drawn[i] != 0) << i;
+	return mask;
+}
 
-		move_rect(&vbo_data[i * 6], s->x, s->y, s->z, SPRITE_WIDTH, SPRITE_HEIGHT);
+static u32 cmdBufOffset(void)
+{
+	u32 *buf, size, offset;
+	GPUCMD_GetBuffer(&buf, &size, &offset);
+	return offset;
+}
+
+static void invalidateEyes(void)
+{
+	for (int i = 0; i < VBO_RING_MAX; i++) {
+		eyes[i][0].valid = false;
+		eyes[i][1].valid = false;
+	}
+}
+
+// Whether the current slot's recording of eye can be replayed this frame
+static bool eyeCached(int eye)
+{
+	const recorded_eye *r = &eyes[current_slot][eye];
+	return r->valid && r->buckets == drawnBuckets();
+}
 
-		if (s->x < 0 || s->x + SPRITE_WIDTH > (float)GSP_SCREEN_HEIGHT_TOP) {
-			s->velocity_x *= -1;
+// Everything but the target, the parallax and the vertex counts is invariant
+// while the path and the buckets drawn stay the same, so an eye is recorded
+// once and replayed with just those words patched. The recording holds
+// whatever citro3d had dirty at the time, so it is only valid while nothing
+// else goes through citro3d; switching paths, atlases or modes throws it
+// away. Returns true if the eye was replayed rather than drawn.
+static bool sceneRenderEye(int eye, float iod)
+{
+	recorded_eye *r = &eyes[current_slot][eye];
+	bool replay = submit_mode == SUBMIT_CACHED || (submit_mode == SUBMIT_REPLAY && eye == 1);
+
+	// The instanced path's sprites would be in the recording itself, so
+	// it is never replayed and not worth recording
+	if (!replay || paths[current_path] == &path_instanced) {
+		sceneRender(iod);
+		return false;
+	}
+
+	if (eyeCached(eye)) {
+		cmdlist_patch_float(&r->commands, &r->parallax, iod);
+		int draw = 0;
+		for (int i = 0; i < NUM_ATLASES; i++) {
+			if (drawn[i])
+				cmdlist_patch_nth(&r->commands, &r->vertices, draw++, drawn[i] * paths[current_path]->draw_vertices);
 		}
-		if (s->y < 0 || s->y + SPRITE_HEIGHT > (float)GSP_SCREEN_WIDTH) {
-			s->velocity_y *= -1;
+		frame_draws += draw;
+		cmdlist_replay(&r->commands);
+		return true;
+	}
+
+	cmdlist_begin(&r->commands);
+	int draws = sceneRender(iod);
+	// Only patch lists with one draw per bucket; anything else, like batched
+	// draws, gets re-recorded through citro3d every frame
+	r->buckets = drawnBuckets();
+	r->valid = cmdlist_end(&r->commands) &&
+		draws == __builtin_popcount(r->buckets) && draws <= CMDLIST_MAX_PATCHES &&
+		cmdlist_find_uniform(&r->commands, paths[current_path]->program->uLoc_depthinfo, 0, &r->parallax) == draws &&
+		cmdlist_find_register(&r->commands, GPUREG_NUMVERTICES, &r->vertices) == draws;
+	return false;
+}
+
+static void sceneExit(void)
+{
+	// Free the textures
+	for (int i = 0; i < NUM_ATLASES; i++)
+		C3D_TexDelete(&textures[i]);
+
+	// Free the VBOs and shader programs
+	for (size_t i = 0; i < NUM_PATHS; i++)
+		paths[i]->exit();
+	sprite_store_free(&sprites);
+	sprite_store_free(&view);
+	sprite_order_free(&order);
+	sprite_world_fini(&world);
+	fixed_kinematics_free(&fixed);
+	collision_grid_free(&grid);
+	dirty_free(&dirty);
+	atlas_buckets_free(&buckets);
+	for (int i = 0; i < VBO_RING_MAX; i++) {
+		cmdlist_free(&eyes[i][0].commands);
+		cmdlist_free(&eyes[i][1].commands);
+	}
+}
+
+static bool paused = false;
+
+// Have every slot rebuilt from the store when it is next selected
+static void invalidateSlots(void)
+{
+	// Whatever moves sprites in the store invalidates the slots, so the
+	// world and the fixed-point copy follow them
+	sim_stale = true;
+	for (int i = 0; i < VBO_RING_MAX; i++)
+		slots[i].stale = true;
+	invalidateEyes();
+}
+
+// Bring the selected slot up to date with everything but this frame's
+// simulation step
+static void prepareSlot(void)
+{
+	ring_slot *slot = &slots[current_slot];
+	const render_path *path = paths[current_path];
+
+	if (slot->stale) {
+		PROFILE_ZONE("rebuild");
+		for (int i = 0; i < NUM_ATLASES; i++) {
+			vbo_bytes += path->rebuild(&sprites, buckets.first[i], buckets.size[i], atlases[i]);
+			dirty_mark(&dirty, buckets.first[i], buckets.size[i]);
+			slot->uv_valid[i] = buckets.size[i];
 		}
+		slot->stale = false;
+		slot->sim_step = sim_step;
+	}
+
+	for (int i = 0; i < NUM_ATLASES; i++) {
+		int valid = slot->uv_valid[i];
+		if (buckets.visible[i] <= valid)
+			continue;
+		PROFILE_ZONE("uv rebuild");
+		vbo_bytes += path->retexture(&sprites, buckets.first[i] + valid, buckets.visible[i] - valid, atlases[i]);
+		dirty_mark(&dirty, buckets.first[i] + valid, buckets.visible[i] - valid);
+		slot->uv_valid[i] = buckets.visible[i];
 	}
 }
 
-static void sceneRender(float iod)
+// Set when the pool could not grow any further
+static bool out_of_memory = false;
+
+// Grow the pool, and the current path's buffers with it, to hold count
+// sprites. Returns the count that fits.
+static int reserveSprites(int count)
 {
-	// Update the uniforms
-	C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &projection);
-	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_tint, 1.0f, 1.0f, 1.0f, 1.0f);
-	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_depthinfo, iod, MIN_DEPTH, MAX_DEPTH, DEEPNESS);
+	if (count <= buckets.sorted)
+		return count;
 
-	// Draw the VBO
-	C3D_DrawArrays(GPU_TRIANGLES, 0, current_sprites * 6);
+	PROFILE_ZONE("grow pool");
+	int old_count = buckets.sorted;
+	if (!sprite_store_reserve(&sprites, count) || !sprite_store_reserve(&view, sprites.capacity) ||
+		!dirty_reserve(&dirty, sprites.capacity)) {
+		out_of_memory = true;
+		return old_count;
+	}
+
+	// The buffers move, so wait until the GPU is done with the old ones.
+	// Recorded commands pointing at them are stale either way.
+	const render_path *path = paths[current_path];
+	fence_drain();
+	invalidateSlots();
+	if (!path->reserve(sprites.capacity, ring_slots)) {
+		// Keep drawing from the old buffers; the pool is just ahead of them
+		out_of_memory = true;
+		return old_count;
+	}
+	path->bind();
+
+	// The new sprites join their atlases' buckets, which moves the buckets
+	// after the first; only sorted sprites are ever written or drawn
+	randomizeSprites(old_count, sprites.capacity - old_count);
+	if (!sortSprites(old_count, sprites.capacity)) {
+		out_of_memory = true;
+		return old_count;
+	}
+	out_of_memory = false;
+	return count;
 }
 
-static void sceneExit(void)
+#define TRACE_PATH "sdmc:/3dstest-trace.json"
+
+// Result of the last trace dump, for the HUD
+static const char *trace_status = "Y saves " TRACE_PATH;
+
+static void saveTrace(void)
 {
-	// Free the texture
-	C3D_TexDelete(&texture_110);
+	FILE *f = fopen(TRACE_PATH, "w");
+	if (!f) {
+		trace_status = "trace: can't open file";
+		return;
+	}
+	profile_write_trace(f);
+	trace_status = fclose(f) ? "trace: write failed" : "trace: saved " TRACE_PATH;
+}
 
-	// Free the VBO
-	linearFree(vbo_data);
+// Sprites at the start of store range [first, end) that have texcoords in a
+// slot, from the ranges of the buckets that started at old_first
+static int validPrefix(const ring_slot *slot, const int *old_first, int first, int end)
+{
+	int p = first;
+	for (bool grew = true; grew && p < end;) {
+		grew = false;
+		for (int i = 0; i < NUM_ATLASES; i++) {
+			int valid_end = old_first[i] + slot->uv_valid[i];
+			if (p >= old_first[i] && p < valid_end) {
+				p = valid_end < end ? valid_end : end;
+				grew = true;
+			}
+		}
+	}
+	return p - first;
+}
 
-	// Free the shader program
-	shaderProgramFree(&program);
-	DVLB_Free(vshader_dvlb);
+// Give every sprite an atlas for the new mode and bucket them again. The
+// buckets move, so each slot is rebuilt when it is next selected, unless its
+// vertices name atlas entries and the sprites stayed in place.
+static void atlasChanged(void)
+{
+	PROFILE_ZONE("rebucket");
+	int old_first[NUM_ATLASES];
+	memcpy(old_first, buckets.first, sizeof(old_first));
+	// The sort is stable, so sprites whose atlases are already in order stay
+	// where they are
+	bool in_place = true;
+	for (int i = 0; i < buckets.sorted; i++) {
+		sprites.atlas[i] = pickAtlas();
+		in_place &= i == 0 || sprites.atlas[i] >= sprites.atlas[i - 1];
+	}
+	if (!sortSprites(0, buckets.sorted))
+		svcBreak(USERBREAK_PANIC);
+	atlas_buckets_show(&buckets, current_sprites);
+	const render_path *path = paths[current_path];
+	if (!in_place || (path != &path_uvlut && path != &path_instanced)) {
+		invalidateSlots();
+		return;
+	}
+
+	// The uv table and instanced paths name entries, not texcoords, so they
+	// hold for any atlas: only the buckets they are drawn in changed, and
+	// with them the table each draw uploads
+	for (int s = 0; s < VBO_RING_MAX; s++) {
+		ring_slot *slot = &slots[s];
+		int uv_valid[NUM_ATLASES];
+		for (int i = 0; i < NUM_ATLASES; i++)
+			uv_valid[i] = validPrefix(slot, old_first, buckets.first[i], buckets.first[i] + buckets.size[i]);
+		memcpy(slot->uv_valid, uv_valid, sizeof(uv_valid));
+	}
+	invalidateEyes();
 }
 
-static bool paused = false;
+static const char *describeAtlas(int value)
+{
+	static const char *const names[NUM_ATLAS_MODES] = {"110px", "64px", "mixed"};
+	return names[value];
+}
+
+#define BENCH_CSV_PATH "sdmc:/3dstest-bench.csv"
+#define BENCH_STEP_FRAMES (120)
+
+// The scripted benchmark: while it runs it owns the sprite count, the atlas
+// and the parallax, and the simulation steps by a fixed delta
+static int benchmark = 0;
+static script_run script;
+// For the HUD's last row, which is 40 columns wide
+static const char *bench_status = "Bench writes " BENCH_CSV_PATH;
+
+static void applyScriptStep(void)
+{
+	script_step step = script_current(&script);
+	current_sprites = step.sprites;
+	int mode = step.large_atlas ? ATLAS_MODE_110 : ATLAS_MODE_64;
+	if (mode != atlas_mode) {
+		atlas_mode = mode;
+		atlasChanged();
+	}
+}
+
+static void stopBenchmark(const char *status)
+{
+	if (script.csv)
+		fclose(script.csv);
+	script.csv = NULL;
+	benchmark = 0;
+	bench_status = status;
+}
+
+static void benchmarkChanged(void)
+{
+	if (!benchmark) {
+		stopBenchmark("benchmark: stopped");
+		return;
+	}
+
+	FILE *csv = fopen(BENCH_CSV_PATH, "w");
+	if (!csv) {
+		stopBenchmark("benchmark: can't open CSV");
+		return;
+	}
+
+	// Every run starts from the same scene
+	srand(SCRIPT_SEED);
+	randomizeSprites(0, buckets.sorted);
+	if (!sortSprites(0, buckets.sorted))
+		svcBreak(USERBREAK_PANIC);
+	invalidateSlots();
+
+	script_start(&script, csv, BENCH_STEP_FRAMES);
+	applyScriptStep();
+	bench_status = "benchmark: running";
+}
+
+static const char *describeBenchmark(int value)
+{
+	return value ? "running" : "off";
+}
+
+// Size the current path's ring for the pool and the slot count. Its buffers
+// may move, so the GPU has to be done with them first.
+static void reserveRing(void)
+{
+	fence_drain();
+	if (!paths[current_path]->reserve(sprites.capacity, ring_slots))
+		svcBreak(USERBREAK_PANIC);
+	paths[current_path]->bind();
+	invalidateSlots();
+}
+
+static void arenaChanged(void)
+{
+	sprite_store_set_arena(&sprites, buckets.sorted, (arena - 1) * GSP_SCREEN_HEIGHT_TOP / 2.0f);
+	invalidateSlots();
+}
+
+static const char *describeArena(int value)
+{
+	static const char *const names[] = {"screen", "2x", "3x", "4x"};
+	return names[value - 1];
+}
+
+static const char *describeSwitch(int value)
+{
+	return value ? "on" : "off";
+}
+
+static const char *describeOrder(int value)
+{
+	return order_keys[value] ? order_keys[value]->name : "off";
+}
+
+// Order by the new key from scratch. Sorted slots hold gathered sprites, so
+// they are rebuilt too.
+static void orderChanged(void)
+{
+	if (order_keys[sort_order] && order.key != order_keys[sort_order]) {
+		order.key = order_keys[sort_order];
+		for (int i = 0; i < NUM_ATLASES; i++)
+			sprite_order_sort(&order, &sprites, buckets.first[i], buckets.size[i]);
+	}
+	invalidateSlots();
+}
+
+static const char *describeSimulation(int value)
+{
+	static const char *const names[NUM_SIMS] = {"store", "flecs", "fixed"};
+	return names[value];
+}
+
+// The store kept moving while the other simulation ran
+static void simulationChanged(void)
+{
+	sim_stale = true;
+}
+
+static void earlyDepthChanged(void)
+{
+	// Cleared to 0 with the depth buffer, so GREATER matches the full test
+	C3D_EarlyDepthTest(early_depth, GPU_EARLYDEPTH_GREATER, 0);
+	invalidateEyes();
+}
+
+static void pathChanged(void)
+{
+	// Paths only keep the active buffers current, so bring the new one up to date
+	reserveRing();
+}
+
+static const char *describePath(int value)
+{
+	return paths[value]->name;
+}
+
+static const char *describeSubmit(int value)
+{
+	static const char *const names[NUM_SUBMIT_MODES] = {"redraw", "replay R", "cached"};
+	return names[value];
+}
+
+// A runtime setting on the bottom screen menu: L/R picks a row, A/B step it
+typedef struct {
+	const char *label;
+	int *value;
+	int min;
+	int max;
+	// Name of a value, or NULL to print the number
+	const char *(*describe)(int value);
+	// Called after the value changed
+	void (*changed)(void);
+} option;
+
+static const option options[] = {
+	{"Path", &current_path, 0, NUM_PATHS - 1, describePath, pathChanged},
+	{"Threads", &update_threads, 1, JOBS_MAX_THREADS, NULL, NULL},
+	{"Submit", &submit_mode, 0, NUM_SUBMIT_MODES - 1, describeSubmit, invalidateEyes},
+	{"Benchmark", &benchmark, 0, 1, describeBenchmark, benchmarkChanged},
+	{"VBOs", &ring_slots, 1, VBO_RING_MAX, NULL, reserveRing},
+	// Culled and sorted slots hold gathered sprites, so switching rebuilds
+	// them
+	{"Cull", &culling, 0, 1, describeSwitch, invalidateSlots},
+	{"Arena", &arena, 1, 4, describeArena, arenaChanged},
+	{"Order", &sort_order, 0, NUM_ORDERS - 1, describeOrder, orderChanged},
+	{"EarlyZ", &early_depth, 0, 1, describeSwitch, earlyDepthChanged},
+	{"Collide", &colliding, 0, 1, describeSwitch, NULL},
+	{"Sim", &simulation, 0, NUM_SIMS - 1, describeSimulation, simulationChanged},
+};
+#define NUM_OPTIONS (sizeof(options) / sizeof(options[0]))
+static size_t current_option = 0;
+
+static void optionsInput(u32 kDown)
+{
+	if (kDown & KEY_R)
+		current_option = (current_option + 1) % NUM_OPTIONS;
+	if (kDown & KEY_L)
+		current_option = (current_option + NUM_OPTIONS - 1) % NUM_OPTIONS;
+
+	const option *o = &options[current_option];
+	int value = *o->value;
+	if (kDown & KEY_A)
+		value = value < o->max ? value + 1 : o->min;
+	if (kDown & KEY_B)
+		value = value > o->min ? value - 1 : o->max;
+	if (value != *o->value) {
+		*o->value = value;
+		if (o->changed)
+			o->changed();
+	}
+}
+
+// Options shown at once; the list scrolls to keep the selected one in view
+#define OPTIONS_ROWS (5)
+
+// Returns the row after the block
+static int optionsPrint(int row)
+{
+	printf("\x1b[%d;1H  Options (L/R select, A/B change)\x1b[K", row++);
+	size_t top = current_option < OPTIONS_ROWS ? 0 : current_option - OPTIONS_ROWS + 1;
+	for (size_t i = top; i < top + OPTIONS_ROWS && i < NUM_OPTIONS; i++) {
+		const option *o = &options[i];
+		char marker = i == current_option ? '>' : ' ';
+		if (o->describe)
+			printf("\x1b[%d;1H%c%10s: %s\x1b[K", row++, marker, o->label, o->describe(*o->value));
+		else
+			printf("\x1b[%d;1H%c%10s: %d\x1b[K", row++, marker, o->label, *o->value);
+	}
+	return row;
+}
+
+typedef struct {
+	// False to only write the current positions, for a slot that missed
+	// steps while paused
+	bool step;
+	// False to leave the vertices to the cull stage
+	bool emit;
+	float delta;
+	// Fixed-point steps to take instead, with SIM_FIXED
+	int ticks;
+	// Store index of the bucket being updated
+	int base;
+	size_t bytes;
+} update_job;
+
+static void updateChunk(void *ctx, int first, int count)
+{
+	update_job *job = ctx;
+	first += job->base;
+	if (job->step && simulation == SIM_FIXED)
+		fixed_kinematics_update(&fixed, &sprites, first, count, job->ticks);
+	else if (job->step)
+		sprite_store_update(&sprites, first, count, job->delta);
+	if (!job->emit)
+		return;
+
+	// Sprites at rest keep the vertices they have
+	size_t bytes = 0;
+	int end = first + count;
+	for (int run; (run = sprite_store_next_moving(&sprites, &first, end)); first += run) {
+		bytes += paths[current_path]->move(&sprites, first, run);
+		dirty_mark(&dirty, first, run);
+	}
+	__atomic_fetch_add(&job->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+	int base;
+	Tex3DS_Texture t3x;
+	size_t bytes;
+} emit_job;
+
+// The update jobs' work as the flecs pipeline, on as many threads. Returns
+// the bytes written.
+static size_t updateWorld(bool step, bool emit, float delta)
+{
+	if (sim_stale) {
+		PROFILE_ZONE("flecs load");
+		if (!sprite_world_load(&world, &sprites, buckets.sorted))
+			svcBreak(USERBREAK_PANIC);
+		sim_stale = false;
+	}
+	sprite_world_set_threads(&world, update_threads);
+
+	sprite_world_frame frame = sprite_world_frame_for(&sprites, buckets.first, buckets.visible, NUM_ATLASES);
+	frame.delta = step ? delta : 0.0f;
+	if (emit) {
+		// Unlike the jobs this rewrites sprites at rest too
+		const render_path *path = paths[current_path];
+		frame.vbo = path->vertices();
+		frame.layout = path->layout;
+		for (int i = 0; i < NUM_ATLASES; i++)
+			dirty_mark(&dirty, buckets.first[i], buckets.visible[i]);
+	}
+	return sprite_world_progress(&world, &frame);
+}
+
+// Fixed-point steps for this frame, reloading the copy first if the store
+// changed under it
+static int fixedTicks(float delta)
+{
+	if (sim_stale) {
+		PROFILE_ZONE("fixed load");
+		if (!fixed_kinematics_load(&fixed, &sprites, buckets.sorted))
+			svcBreak(USERBREAK_PANIC);
+		sim_stale = false;
+	}
+	return fixed_kinematics_ticks(&fixed, delta);
+}
+
+// Write complete vertices for gathered sprites
+static void emitChunk(void *ctx, int first, int count)
+{
+	emit_job *job = ctx;
+	first += job->base;
+	size_t bytes = paths[current_path]->rebuild(&view, first, count, job->t3x);
+	dirty_mark(&dirty, first, count);
+	__atomic_fetch_add(&job->bytes, bytes, __ATOMIC_RELAXED);
+}
 
 int main()
 {
@@ -242,7 +887,8 @@ int main()
 	// Initialize graphics
 	gfxInitDefault();
 	gfxSet3D(true);
-	C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
+	C3D_Init(RENDER_CMDBUF_SIZE);
+	fence_init();
 	consoleInit(GFX_BOTTOM, NULL);
 
 	// Initialize the render target
@@ -254,18 +900,27 @@ int main()
 	// Initialize the scene
 	sceneInit();
 
+	jobs = jobs_create(JOBS_MAX_THREADS);
+	if (!jobs)
+		svcBreak(USERBREAK_PANIC);
+
 	TickCounter counter;
 	osTickCounterStart(&counter);
 
 	// Main loop
 	while (aptMainLoop())
 	{
-		// Render the scene
-		C3D_FrameBegin(/*C3D_FRAME_SYNCDRAW*/0);
+		u64 frame_start = svcGetSystemTick();
 
-		hidScanInput();
+		{
+			PROFILE_ZONE("hidScanInput");
+			hidScanInput();
+		}
 
 		float iod = osGet3DSliderState();
+		bool scripted = script_running(&script);
+
+		vbo_bytes = 0;
 
 		// Respond to user input
 		u32 kDown = hidKeysDown();
@@ -273,56 +928,244 @@ int main()
 			break; // break in order to return to hbmenu
 		if (kDown & KEY_SELECT)
 			paused = !paused;
+		if (kDown & KEY_Y)
+			saveTrace();
 			
-		u32 kHeld = hidKeysHeld();
+		u32 kHeld = scripted ? 0 : hidKeysHeld();
 		if ((kHeld & KEY_UP) && current_sprites < MAX_SPRITES)
-			current_sprites++;
+			current_sprites = reserveSprites(current_sprites + 1);
 		if ((kHeld & KEY_DOWN) && current_sprites > 1)
 			current_sprites--;
-			
-		if ((kDown & KEY_RIGHT) && current_sprites)
-			current_sprites = min(current_sprites + 100, MAX_SPRITES);
-		if (kDown & KEY_LEFT)
-			current_sprites = max(current_sprites - 100, 1);
-
-		if (kDown & KEY_X) {
-			largetex = !largetex;
-			if (largetex) {
-				C3D_TexBind(0, &texture_110);
+
+		// Bigger steps once there are thousands to get through
+		int step = current_sprites < 2000 ? 100 : 1000;
+		if ((kDown & KEY_RIGHT) && current_sprites && !scripted)
+			current_sprites = reserveSprites(min(current_sprites + step, MAX_SPRITES));
+		if ((kDown & KEY_LEFT) && !scripted)
+			current_sprites = max(current_sprites - step, 1);
+
+		if ((kDown & KEY_X) && !scripted) {
+			atlas_mode = (atlas_mode + 1) % NUM_ATLAS_MODES;
+			atlasChanged();
+		}
+
+		optionsInput(kDown);
+
+		// The menu may have just started or stopped the benchmark
+		scripted = script_running(&script);
+		if (scripted)
+			iod = script_current(&script).stereo ? SCRIPT_IOD : 0.0f;
+
+		atlas_buckets_show(&buckets, current_sprites);
+
+		osTickCounterUpdate(&counter);
+		double frametime = osTickCounterRead(&counter);
+
+		// Write into the slot the GPU read longest ago. Its frame is normally
+		// done by now; with a single slot this waits for the last one.
+		current_slot = (current_slot + 1) % ring_slots;
+		ring_slot *slot = &slots[current_slot];
+		{
+			PROFILE_ZONE("fence wait");
+			fence_wait_ms = fence_wait(slot->fence) / CPU_TICKS_PER_MSEC;
+		}
+		paths[current_path]->select(current_slot);
+		// Culling and sorting gather what is drawn and rewrite all of it
+		// every frame
+		bool gather = culling || sort_order;
+		bool analytic = paths[current_path] == &path_analytic && !gather && !colliding;
+		if (analytic != analytic_moving || analytic_ticks >= ANALYTIC_REBASE_TICKS) {
+			// Rebuilt from where the shader drew them last, with the
+			// velocities it goes by
+			PROFILE_ZONE("analytic catch up");
+			analytic_advance(&sprites, 0, buckets.sorted, analytic_ticks);
+			analytic_ticks = 0.0f;
+			analytic_moving = analytic;
+			invalidateSlots();
+		}
+		if (!gather)
+			prepareSlot();
+
+		// Collisions only change velocities, which the update then follows
+		if (colliding && !paused) {
+			PROFILE_ZONE("collide");
+			if (collision_grid_build(&grid, &sprites, buckets.first, buckets.visible, NUM_ATLASES))
+				collision_grid_collide(&grid, &sprites);
+			sim_stale = true;
+		}
+
+		// Runs before C3D_FrameBegin(), which waits for the GPU to finish
+		// the last frame, so with more than one slot the two overlap
+		if (analytic) {
+			// Nothing to write; the clock is baked into recorded eyes
+			if (!paused) {
+				analytic_ticks += (scripted ? SCRIPT_DELTA_MS : frametime) / ANALYTIC_TICK_MS;
+				invalidateEyes();
+			}
+		} else if (!paused || (!gather && slot->sim_step != sim_step)) {
+			PROFILE_ZONE("update");
+			float delta = scripted ? SCRIPT_DELTA_MS : frametime;
+			if (simulation == SIM_FLECS) {
+				vbo_bytes += updateWorld(!paused, !gather, delta);
 			} else {
-				C3D_TexBind(0, &texture_64);
+				// Returns once every chunk is written, before the VBO is submitted
+				update_job job = {!paused, !gather, delta, 0, 0, 0};
+				if (simulation == SIM_FIXED && !paused)
+					job.ticks = fixedTicks(delta);
+				for (int i = 0; i < NUM_ATLASES; i++) {
+					if (!buckets.visible[i])
+						continue;
+					job.base = buckets.first[i];
+					jobs_run(jobs, update_threads, updateChunk, &job, buckets.visible[i], 64);
+				}
+				vbo_bytes += job.bytes;
 			}
-			for (int i = 0; i < MAX_SPRITES; i++) {
-				spriteinfo *s = &sprites[i];
-				const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(largetex ? t3x_110 : t3x_64, s->t3x_index);
-				uv_rect(&vbo_data[i * 6], ts);
+			if (!paused)
+				sim_step++;
+			slot->sim_step = sim_step;
+		}
+
+		// Sprites moved since the order was last repaired. Drawn sprites move
+		// a few pixels a frame, so only a few swap places.
+		if (sort_order && order.key->moves && !paused) {
+			PROFILE_ZONE("order repair");
+			for (int i = 0; i < NUM_ATLASES; i++)
+				sprite_order_repair(&order, &sprites, buckets.first[i], buckets.size[i]);
+		}
+
+		if (gather) {
+			PROFILE_ZONE("gather");
+			for (int i = 0; i < NUM_ATLASES; i++) {
+				int first = buckets.first[i];
+				if (sort_order)
+					drawn[i] = sprite_order_gather(&order, &sprites, first, buckets.size[i], buckets.visible[i], culling, iod, &view, first);
+				else
+					drawn[i] = sprite_store_cull(&sprites, first, buckets.visible[i], iod, &view, first);
+				if (!drawn[i])
+					continue;
+				emit_job job = {first, atlases[i], 0};
+				jobs_run(jobs, update_threads, emitChunk, &job, drawn[i], 64);
+				vbo_bytes += job.bytes;
 			}
+		} else {
+			memcpy(drawn, buckets.visible, sizeof(drawn));
 		}
 
-		osTickCounterUpdate(&counter);
-		double frametime = osTickCounterRead(&counter);
+		path_analytic_clock(analytic_ticks, sprites.margin);
+
+		{
+			PROFILE_ZONE("flush");
+			flush_bytes = 0;
+			// The whole pool, since buckets put drawn sprites all over it
+			// and a slot's writes must be flushed while it is selected
+			flush_ranges = dirty_collect(&dirty, buckets.sorted);
+			for (int i = 0; i < flush_ranges; i++)
+				flush_bytes += paths[current_path]->flush(dirty.ranges[i].first, dirty.ranges[i].count);
+		}
 
-		if (!paused)
-			update(frametime);
+		// Render the scene
+		C3D_FrameBegin(/*C3D_FRAME_SYNCDRAW*/0);
 
+		frame_draws = 0;
+		// A replayed eye bypasses citro3d, so an eye recorded after it would
+		// miss the framebuffer flush between the two: record both or neither
+		if (submit_mode == SUBMIT_CACHED && iod > 0.0f && !(eyeCached(0) && eyeCached(1))) {
+			eyes[current_slot][0].valid = false;
+			eyes[current_slot][1].valid = false;
+		}
+		u32 cmdbuf_start = cmdBufOffset();
 		C3D_RenderTargetClear(left_target, C3D_CLEAR_ALL, CLEAR_COLOR, 0);
 		C3D_FrameDrawOn(left_target);
-		sceneRender(iod);
+		bool replayed;
+		{
+			PROFILE_ZONE("render left");
+			replayed = sceneRenderEye(0, iod);
+		}
 		if (iod > 0.0f) {
+			PROFILE_ZONE("render right");
 			C3D_RenderTargetClear(right_target, C3D_CLEAR_ALL, CLEAR_COLOR, 0);
 			C3D_FrameDrawOn(right_target);
-			sceneRender(-iod);
+			replayed &= sceneRenderEye(1, -iod);
+		}
+		if (replayed)
+			cmdlist_end_frame();
+		submit_bytes[submit_mode] = (cmdBufOffset() - cmdbuf_start) * sizeof(u32);
+		// With every sprite culled there may be nothing to submit, and then
+		// no interrupt would ever complete the fence. The slot was not read,
+		// so it keeps its last one.
+		if (cmdBufOffset() > 0)
+			slot->fence = fence_submit(frame_start);
+		{
+			PROFILE_ZONE("C3D_FrameEnd");
+			// Vertex data was flushed range by range above, so only the
+			// command list needs it
+			C3D_FrameEnd(GX_CMDLIST_FLUSH);
 		}
-		C3D_FrameEnd(0);
 
-		printf("\x1b[1;1H  Sprites: %zu/%u\x1b[K", current_sprites, MAX_SPRITES);
+		submit_cpu[submit_mode] = C3D_GetProcessingTime();
+		submit_cmdbuf[submit_mode] = C3D_GetCmdBufUsage();
+
+		script_sample sample = {C3D_GetProcessingTime(), C3D_GetDrawingTime(), C3D_GetCmdBufUsage(), frametime};
+		if (script_frame(&script, &sample)) {
+			if (script_running(&script))
+				applyScriptStep();
+			else
+				stopBenchmark("benchmark: saved CSV");
+		}
+
+		PROFILE_ZONE("HUD");
+		printf("\x1b[1;1H  Sprites: %d/%d%s\x1b[K", current_sprites, sprites.capacity, out_of_memory ? " (out of memory)" : "");
 		printf("\x1b[2;1H      CPU: %.2fms\x1b[K", C3D_GetProcessingTime());
 		printf("\x1b[3;1H      GPU: %.2fms\x1b[K", C3D_GetDrawingTime());
 		printf("\x1b[4;1H   CmdBuf: %.2f%%\x1b[K", C3D_GetCmdBufUsage()*100.0f);
 		printf("\x1b[5;1HFrametime: %.2fms\x1b[K", frametime);
 		printf("\x1b[6;1H      FPS: %.2f\x1b[K", 1.0 / frametime * 1000.0);
+		printf("\x1b[7;1H  Threads: %d/%d\x1b[K", update_threads, jobs_threads(jobs));
+		printf("\x1b[8;1HVBO write: %zu B/frame\x1b[K", vbo_bytes);
+		printf("\x1b[9;1H  Touched: %zu B/frame, %d flushes\x1b[K", flush_bytes, flush_ranges);
+		printf("\x1b[10;1H      Mem: %zuK+%zuK, %uK free\x1b[K", (sprite_store_memory(&sprites) + sprite_store_memory(&view)) / 1024,
+			paths[current_path]->memory() / 1024, (unsigned)(linearSpaceFree() / 1024));
+		printf("\x1b[11;1H     Ring: %d, wait %.2fms, lat %.2fms\x1b[K", ring_slots, fence_wait_ms, fence_latency_ms());
+		printf("\x1b[12;1H    Atlas: %s (X), %d buckets\x1b[K", describeAtlas(atlas_mode), __builtin_popcount(drawnBuckets()));
+		int total_drawn = 0;
+		for (int i = 0; i < NUM_ATLASES; i++)
+			total_drawn += drawn[i];
+		printf("\x1b[13;1H    Drawn: %d sprites in %d draws\x1b[K", total_drawn, frame_draws);
+
+		if (sort_order)
+			printf("\x1b[14;1H    Order: %s, %d swaps, %d sorts\x1b[K", order.key->name, order.swaps, order.full_sorts);
+		else
+			printf("\x1b[14;1H    Order: off\x1b[K");
+		order.swaps = 0;
+		order.full_sorts = 0;
+
+		if (colliding)
+			printf("\x1b[15;1H  Collide: %d pairs, %d hits\x1b[K", grid.tested, grid.contacts);
+		else
+			printf("\x1b[15;1H  Collide: off\x1b[K");
+
+		// Two paths to a row: the bottom screen has 30 rows and 40 columns
+		int row = 16;
+		for (size_t i = 0; i < NUM_PATHS; i++)
+			printf("\x1b[%d;%dH%c%8s: %6.1fK%s", row + (int)i / 2, i % 2 ? 21 : 1, (int)i == current_path ? '>' : ' ',
+				paths[i]->name, current_sprites * paths[i]->move_bytes / 1024.0f, i % 2 ? "" : "\x1b[K");
+		row += (NUM_PATHS + 1) / 2;
+		for (int i = 0; i < NUM_SUBMIT_MODES; i++)
+			printf("\x1b[%d;1H%c%8s: %.2fms %.2f%% %uB\x1b[K", row++, i == submit_mode ? '>' : ' ',
+				describeSubmit(i), submit_cpu[i], submit_cmdbuf[i] * 100.0f, (unsigned)submit_bytes[i]);
+		// The bottom screen has 30 rows, so the blocks go without spacing
+		row = optionsPrint(row);
+		printf("\x1b[%d;1H%s\x1b[K", row++, trace_status);
+		if (script_running(&script))
+			printf("\x1b[%d;1Hbenchmark: step %d/%d\x1b[K", row++, script.step + 1, script_num_steps());
+		else
+			printf("\x1b[%d;1H%s\x1b[K", row++, bench_status);
 	}
 
+	jobs_destroy(jobs);
+	// The GPU may still be reading the buffers about to be freed
+	fence_exit();
+
 	// Deinitialize the scene
 	sceneExit();
 
@@ -0,0 +1,65 @@
+#include "packed_vertex.h"
+
+// Round to nearest; a plain conversion truncates and lrintf() is a libcall
+static inline s16 pack(float value, float scale) {
+	float scaled = value * scale;
+	return scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f;
+}
+
+void add_packed_quad(packed_vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts) {
+	move_packed_quad(dest, x, y, z, width, height);
+	uv_packed_quad(dest, ts);
+}
+
+void move_packed_quad(packed_vertex *dest, float x, float y, float z, float width, float height) {
+	s16 left = pack(x, PACKED_POSITION_SCALE);
+	s16 top = pack(y, PACKED_POSITION_SCALE);
+	s16 right = pack(x + width, PACKED_POSITION_SCALE);
+	s16 bottom = pack(y + height, PACKED_POSITION_SCALE);
+	s16 depth = pack(z, PACKED_DEPTH_SCALE);
+
+	dest[0].x = left;
+	dest[0].y = top;
+	dest[0].z = depth;
+	dest[1].x = right;
+	dest[1].y = top;
+	dest[1].z = depth;
+	dest[2].x = left;
+	dest[2].y = bottom;
+	dest[2].z = depth;
+	dest[3].x = right;
+	dest[3].y = bottom;
+	dest[3].z = depth;
+}
+
+void uv_packed_quad(packed_vertex *dest, const Tex3DS_SubTexture *ts) {
+	s16 left = pack(ts->left, PACKED_UV_SCALE);
+	s16 top = pack(ts->top, PACKED_UV_SCALE);
+	s16 right = pack(ts->right, PACKED_UV_SCALE);
+	s16 bottom = pack(ts->bottom, PACKED_UV_SCALE);
+
+	dest[0].u = left;
+	dest[0].v = top;
+	dest[1].u = right;
+	dest[1].v = top;
+	dest[2].u = left;
+	dest[2].v = bottom;
+	dest[3].u = right;
+	dest[3].v = bottom;
+}
+
+void sprite_store_emit_packed(const sprite_store *store, packed_vertex *vbo, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_packed_quad(&vbo[i * SPRITE_QUAD_VERTICES], store->x[i], store->y[i], store->z[i], SPRITE_WIDTH, SPRITE_HEIGHT);
+}
+
+vertex unpack_vertex(const packed_vertex *p) {
+	vertex v = {
+		p->x * (1.0f / PACKED_POSITION_SCALE),
+		p->y * (1.0f / PACKED_POSITION_SCALE),
+		p->z * (1.0f / PACKED_DEPTH_SCALE),
+		p->u * (1.0f / PACKED_UV_SCALE),
+		p->v * (1.0f / PACKED_UV_SCALE),
+	};
+	return v;
+}
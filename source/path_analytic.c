@@ -0,0 +1,164 @@
+#include "render.h"
+#include "analytic_vertex.h"
+#include "analytic_shbin.h"
+
+// Indexed quads whose vertices hold where each sprite started and how fast it
+// goes; the vertex shader bounces them, so nothing is written while they fly
+
+static sprite_program program;
+static int uLoc_arena, uLoc_period, uLoc_clock;
+static vbo_ring ring = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(analytic_vertex)};
+static analytic_vertex *vbo_data;
+// Indices for one batch of MAX_INDEXED_SPRITES sprites, shared by every batch
+static u16 *index_data;
+static float clock_ticks;
+static analytic_uniforms uniforms;
+
+void path_analytic_clock(float ticks, float margin)
+{
+	clock_ticks = ticks;
+	uniforms = analytic_uniforms_for(margin);
+}
+
+// Three attributes, unlike render_bind_buffer()
+static void bind_buffer(const analytic_vertex *data)
+{
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, data, sizeof(analytic_vertex), 3, 0x210);
+}
+
+static bool analytic_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void analytic_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	bind_buffer(vbo_data);
+}
+
+static void *analytic_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool analytic_init(int capacity)
+{
+	if (!sprite_program_load(&program, analytic_shbin, analytic_shbin_size))
+		return false;
+	uLoc_arena = shaderInstanceGetUniformLocation(program.program.vertexShader, "arena");
+	uLoc_period = shaderInstanceGetUniformLocation(program.program.vertexShader, "period");
+	uLoc_clock = shaderInstanceGetUniformLocation(program.program.vertexShader, "clock");
+	uniforms = analytic_uniforms_for(0.0f);
+
+	index_data = linearAlloc(MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!index_data || !analytic_reserve(capacity, 1))
+		return false;
+
+	quad_indices(index_data, MAX_INDEXED_SPRITES);
+	GSPGPU_FlushDataCache(index_data, MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void analytic_exit(void)
+{
+	linearFree(index_data);
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t analytic_memory(void)
+{
+	return vbo_ring_memory(&ring) +
+		MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16);
+}
+
+static void analytic_bind(void)
+{
+	sprite_program_bind(&program);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=start position
+	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 4); // v1=velocity and corner
+	AttrInfo_AddLoader(attrInfo, 2, GPU_FLOAT, 2); // v2=texcoord
+
+	bind_buffer(vbo_data);
+}
+
+static size_t analytic_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		add_analytic_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i],
+			sprites->velocity_x[i], sprites->velocity_y[i], SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+	}
+	return count * SPRITE_QUAD_VERTICES * sizeof(analytic_vertex);
+}
+
+static size_t analytic_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		uv_analytic_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	return count * SPRITE_QUAD_VERTICES * 2 * sizeof(float);
+}
+
+// Only needed while something else moves the sprites, with the clock at 0
+static size_t analytic_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_analytic(sprites, vbo_data, first, count);
+	return count * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+}
+
+static size_t analytic_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int analytic_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_arena, uniforms.arena[0], uniforms.arena[1], uniforms.arena[2], uniforms.arena[3]);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_period, uniforms.period[0], uniforms.period[1], uniforms.period[2], uniforms.period[3]);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_clock, clock_ticks, clock_ticks, clock_ticks, clock_ticks);
+	if (first == 0 && count <= MAX_INDEXED_SPRITES) {
+		C3D_DrawElements(GPU_TRIANGLES, count * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+		return 1;
+	}
+
+	// Rebased and batched like the indexed path
+	int draws = 0;
+	for (int end = first + count; first < end; first += MAX_INDEXED_SPRITES, draws++) {
+		int batch = end - first < MAX_INDEXED_SPRITES ? end - first : MAX_INDEXED_SPRITES;
+		bind_buffer(&vbo_data[first * SPRITE_QUAD_VERTICES]);
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	bind_buffer(vbo_data);
+	return draws;
+}
+
+const render_path path_analytic = {
+	"analytic",
+	&program,
+	SPRITE_QUAD_VERTICES * 3 * sizeof(float),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_ANALYTIC_QUADS,
+	analytic_init,
+	analytic_exit,
+	analytic_reserve,
+	analytic_select,
+	analytic_vertices,
+	analytic_memory,
+	analytic_bind,
+	analytic_rebuild,
+	analytic_retexture,
+	analytic_move,
+	analytic_flush,
+	analytic_draw,
+};
@@ -0,0 +1,110 @@
+#include "render.h"
+#include "vshader_shbin.h"
+
+// The original path: six vertices per sprite drawn with C3D_DrawArrays
+
+static sprite_program program;
+static vbo_ring ring = {.sprite_bytes = SPRITE_VERTICES * sizeof(vertex)};
+static vertex *vbo_data;
+
+static bool arrays_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void arrays_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	render_bind_buffer(vbo_data, sizeof(vertex));
+}
+
+static void *arrays_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool arrays_init(int capacity)
+{
+	if (!sprite_program_load(&program, vshader_shbin, vshader_shbin_size))
+		return false;
+
+	// Create the VBO (vertex buffer object)
+	return arrays_reserve(capacity, 1);
+}
+
+static void arrays_exit(void)
+{
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t arrays_memory(void)
+{
+	return vbo_ring_memory(&ring);
+}
+
+static void arrays_bind(void)
+{
+	sprite_program_bind(&program);
+	render_bind_vertices(vbo_data);
+}
+
+static size_t arrays_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		add_rect(&vbo_data[i * SPRITE_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i], SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+	}
+	return count * SPRITE_VERTICES * sizeof(vertex);
+}
+
+static size_t arrays_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		uv_rect(&vbo_data[i * SPRITE_VERTICES], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	return count * SPRITE_VERTICES * 2 * sizeof(float);
+}
+
+static size_t arrays_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit(sprites, vbo_data, first, count);
+	return count * SPRITE_VERTICES * 3 * sizeof(float);
+}
+
+static size_t arrays_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int arrays_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+
+	// Draw the VBO
+	C3D_DrawArrays(GPU_TRIANGLES, first * SPRITE_VERTICES, count * SPRITE_VERTICES);
+	return 1;
+}
+
+const render_path path_arrays = {
+	"arrays",
+	&program,
+	SPRITE_VERTICES * 3 * sizeof(float),
+	SPRITE_VERTICES,
+	LAYOUT_RECTS,
+	arrays_init,
+	arrays_exit,
+	arrays_reserve,
+	arrays_select,
+	arrays_vertices,
+	arrays_memory,
+	arrays_bind,
+	arrays_rebuild,
+	arrays_retexture,
+	arrays_move,
+	arrays_flush,
+	arrays_draw,
+};
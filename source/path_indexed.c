@@ -0,0 +1,132 @@
+#include "render.h"
+#include "vshader_shbin.h"
+
+// Four vertices per sprite, expanded to two triangles by a static index buffer
+
+static sprite_program program;
+static vbo_ring ring = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(vertex)};
+static vertex *vbo_data;
+// Indices for one batch of MAX_INDEXED_SPRITES sprites, shared by every batch
+static u16 *index_data;
+
+static bool indexed_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void indexed_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	render_bind_buffer(vbo_data, sizeof(vertex));
+}
+
+static void *indexed_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool indexed_init(int capacity)
+{
+	if (!sprite_program_load(&program, vshader_shbin, vshader_shbin_size))
+		return false;
+
+	index_data = linearAlloc(MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!index_data || !indexed_reserve(capacity, 1))
+		return false;
+
+	// The indices never change, so write and flush them once
+	quad_indices(index_data, MAX_INDEXED_SPRITES);
+	GSPGPU_FlushDataCache(index_data, MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void indexed_exit(void)
+{
+	linearFree(index_data);
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t indexed_memory(void)
+{
+	return vbo_ring_memory(&ring) +
+		MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16);
+}
+
+static void indexed_bind(void)
+{
+	sprite_program_bind(&program);
+	render_bind_vertices(vbo_data);
+}
+
+static size_t indexed_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		add_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i], SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+	}
+	return count * SPRITE_QUAD_VERTICES * sizeof(vertex);
+}
+
+static size_t indexed_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		uv_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	return count * SPRITE_QUAD_VERTICES * 2 * sizeof(float);
+}
+
+static size_t indexed_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_quads(sprites, vbo_data, first, count);
+	return count * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+}
+
+static size_t indexed_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int indexed_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	if (first == 0 && count <= MAX_INDEXED_SPRITES) {
+		C3D_DrawElements(GPU_TRIANGLES, count * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+		return 1;
+	}
+
+	// u16 indices only reach MAX_INDEXED_SPRITES sprites past the buffer
+	// base, so move the base to the range and along it in batches, then put
+	// it back for the next draw
+	int draws = 0;
+	for (int end = first + count; first < end; first += MAX_INDEXED_SPRITES, draws++) {
+		int batch = end - first < MAX_INDEXED_SPRITES ? end - first : MAX_INDEXED_SPRITES;
+		render_bind_buffer(&vbo_data[first * SPRITE_QUAD_VERTICES], sizeof(vertex));
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	render_bind_buffer(vbo_data, sizeof(vertex));
+	return draws;
+}
+
+const render_path path_indexed = {
+	"indexed",
+	&program,
+	SPRITE_QUAD_VERTICES * 3 * sizeof(float),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_QUADS,
+	indexed_init,
+	indexed_exit,
+	indexed_reserve,
+	indexed_select,
+	indexed_vertices,
+	indexed_memory,
+	indexed_bind,
+	indexed_rebuild,
+	indexed_retexture,
+	indexed_move,
+	indexed_flush,
+	indexed_draw,
+};
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include "render.h"
+#include "instanced_vertex.h"
+#include "instanced_shbin.h"
+
+// No per-sprite vertices: a static buffer of INSTANCED_BATCH canned quads is
+// drawn once per batch, with the batch's sprites uploaded as uniforms
+
+// Command buffer bytes a batch takes at most: the instances at four words
+// each plus the upload's headers, and the draw
+#define BATCH_CMD_BYTES ((INSTANCED_BATCH * 4 + 64) * sizeof(u32))
+
+static sprite_program program;
+static int uLoc_spritesize, uLoc_uvs, uLoc_instances;
+// The GPU never reads instances from here, only from the command buffer, so
+// one array in the ordinary heap serves every ring slot and is never flushed.
+// Whatever a slot writes comes from the store as it is now, so no slot can
+// find it older than its own writes left it.
+static sprite_instance *instance_data;
+static int instance_capacity;
+static instanced_vertex *quad_data;
+static u16 *index_data;
+// The table of the atlas the next draw uses
+static uvlut_table table;
+static Tex3DS_Texture table_t3x;
+// The atlas whose table the uniforms hold, if any; other paths' programs
+// reuse the uniform space
+static Tex3DS_Texture uploaded_t3x;
+
+void path_instanced_atlas(Tex3DS_Texture t3x)
+{
+	if (t3x == table_t3x)
+		return;
+	if (!uvlut_table_for(&table, t3x))
+		svcBreak(USERBREAK_PANIC);
+	table_t3x = t3x;
+}
+
+static void bind_buffer(void)
+{
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, quad_data, sizeof(instanced_vertex), 1, 0x0);
+}
+
+static bool instanced_reserve(int capacity, int slots)
+{
+	if (capacity <= instance_capacity)
+		return true;
+	sprite_instance *grown = malloc(capacity * sizeof(sprite_instance));
+	if (!grown)
+		return false;
+	free(instance_data);
+	instance_data = grown;
+	instance_capacity = capacity;
+	return true;
+}
+
+static void instanced_select(int slot)
+{
+}
+
+static void *instanced_vertices(void)
+{
+	return instance_data;
+}
+
+static bool instanced_init(int capacity)
+{
+	if (!sprite_program_load(&program, instanced_shbin, instanced_shbin_size))
+		return false;
+	uLoc_spritesize = shaderInstanceGetUniformLocation(program.program.vertexShader, "spritesize");
+	uLoc_uvs = shaderInstanceGetUniformLocation(program.program.vertexShader, "uvs");
+	uLoc_instances = shaderInstanceGetUniformLocation(program.program.vertexShader, "instances");
+
+	quad_data = linearAlloc(INSTANCED_BATCH * SPRITE_QUAD_VERTICES * sizeof(instanced_vertex));
+	index_data = linearAlloc(INSTANCED_BATCH * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!quad_data || !index_data || !instanced_reserve(capacity, 1))
+		return false;
+
+	instanced_quads(quad_data);
+	quad_indices(index_data, INSTANCED_BATCH);
+	GSPGPU_FlushDataCache(quad_data, INSTANCED_BATCH * SPRITE_QUAD_VERTICES * sizeof(instanced_vertex));
+	GSPGPU_FlushDataCache(index_data, INSTANCED_BATCH * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void instanced_exit(void)
+{
+	linearFree(index_data);
+	linearFree(quad_data);
+	free(instance_data);
+	instance_data = NULL;
+	instance_capacity = 0;
+	sprite_program_free(&program);
+}
+
+static size_t instanced_memory(void)
+{
+	return INSTANCED_BATCH * (SPRITE_QUAD_VERTICES * sizeof(instanced_vertex) + SPRITE_QUAD_INDICES * sizeof(u16));
+}
+
+static void instanced_bind(void)
+{
+	sprite_program_bind(&program);
+	uploaded_t3x = NULL;
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_spritesize, SPRITE_WIDTH, SPRITE_HEIGHT, 0.0f, 0.0f);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_UNSIGNED_BYTE, 4); // v0=slot and corner
+
+	bind_buffer();
+}
+
+static size_t instanced_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		add_instance(&instance_data[i], sprites->x[i], sprites->y[i], sprites->z[i], sprites->t3x_index[i]);
+	return count * sizeof(sprite_instance);
+}
+
+// Entries are the same in every atlas, as with the uv table path
+static size_t instanced_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		instance_data[i].entry = sprites->t3x_index[i];
+	return count * sizeof(float);
+}
+
+static size_t instanced_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_instances(sprites, instance_data, first, count);
+	return count * 3 * sizeof(float);
+}
+
+static size_t instanced_flush(int first, int count)
+{
+	return 0;
+}
+
+static int instanced_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	if (uploaded_t3x != table_t3x) {
+		C3D_FVec *uvs = C3D_FVUnifWritePtr(GPU_VERTEX_SHADER, uLoc_uvs, UVLUT_ENTRIES);
+		for (int i = 0; i < UVLUT_ENTRIES; i++) {
+			uvs[i].x = table.rect[i][0];
+			uvs[i].y = table.rect[i][1];
+			uvs[i].z = table.rect[i][2];
+			uvs[i].w = table.rect[i][3];
+		}
+		uploaded_t3x = table_t3x;
+	}
+
+	int draws = 0;
+	for (int end = first + count; first < end; first += INSTANCED_BATCH, draws++) {
+		// Every batch copies its instances into the command buffer; rather
+		// than overrun it, leave the rest of the scene undrawn
+		if (C3D_GetCmdBufUsage() > 1.0f - (float)BATCH_CMD_BYTES / RENDER_CMDBUF_SIZE)
+			break;
+		int batch = end - first < INSTANCED_BATCH ? end - first : INSTANCED_BATCH;
+		C3D_FVec *slots = C3D_FVUnifWritePtr(GPU_VERTEX_SHADER, uLoc_instances, batch);
+		for (int i = 0; i < batch; i++) {
+			const sprite_instance *s = &instance_data[first + i];
+			slots[i].x = s->x;
+			slots[i].y = s->y;
+			slots[i].z = s->z;
+			slots[i].w = s->entry;
+		}
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	return draws;
+}
+
+const render_path path_instanced = {
+	"instanced",
+	&program,
+	3 * sizeof(float),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_INSTANCES,
+	instanced_init,
+	instanced_exit,
+	instanced_reserve,
+	instanced_select,
+	instanced_vertices,
+	instanced_memory,
+	instanced_bind,
+	instanced_rebuild,
+	instanced_retexture,
+	instanced_move,
+	instanced_flush,
+	instanced_draw,
+};
@@ -0,0 +1,140 @@
+#include "render.h"
+#include "packed_vertex.h"
+#include "packed_shbin.h"
+
+// Indexed quads in the packed 10-byte vertex layout
+
+static sprite_program program;
+static int uLoc_unpack;
+static vbo_ring ring = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(packed_vertex)};
+static packed_vertex *vbo_data;
+// Indices for one batch of MAX_INDEXED_SPRITES sprites, shared by every batch
+static u16 *index_data;
+
+static bool packed_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void packed_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	render_bind_buffer(vbo_data, sizeof(packed_vertex));
+}
+
+static void *packed_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool packed_init(int capacity)
+{
+	if (!sprite_program_load(&program, packed_shbin, packed_shbin_size))
+		return false;
+	uLoc_unpack = shaderInstanceGetUniformLocation(program.program.vertexShader, "unpack");
+
+	index_data = linearAlloc(MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!index_data || !packed_reserve(capacity, 1))
+		return false;
+
+	quad_indices(index_data, MAX_INDEXED_SPRITES);
+	GSPGPU_FlushDataCache(index_data, MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void packed_exit(void)
+{
+	linearFree(index_data);
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t packed_memory(void)
+{
+	return vbo_ring_memory(&ring) +
+		MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16);
+}
+
+static void packed_bind(void)
+{
+	sprite_program_bind(&program);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_unpack,
+		1.0f / PACKED_POSITION_SCALE, 1.0f / PACKED_POSITION_SCALE, 1.0f / PACKED_DEPTH_SCALE, 1.0f / PACKED_UV_SCALE);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_SHORT, 3); // v0=position and depth
+	AttrInfo_AddLoader(attrInfo, 1, GPU_SHORT, 2); // v1=texcoord
+
+	render_bind_buffer(vbo_data, sizeof(packed_vertex));
+}
+
+static size_t packed_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		add_packed_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i], SPRITE_WIDTH, SPRITE_HEIGHT, ts);
+	}
+	return count * SPRITE_QUAD_VERTICES * sizeof(packed_vertex);
+}
+
+static size_t packed_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		uv_packed_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	return count * SPRITE_QUAD_VERTICES * 2 * sizeof(s16);
+}
+
+static size_t packed_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_packed(sprites, vbo_data, first, count);
+	return count * SPRITE_QUAD_VERTICES * 3 * sizeof(s16);
+}
+
+static size_t packed_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int packed_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	if (first == 0 && count <= MAX_INDEXED_SPRITES) {
+		C3D_DrawElements(GPU_TRIANGLES, count * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+		return 1;
+	}
+
+	// Rebased and batched like the indexed path
+	int draws = 0;
+	for (int end = first + count; first < end; first += MAX_INDEXED_SPRITES, draws++) {
+		int batch = end - first < MAX_INDEXED_SPRITES ? end - first : MAX_INDEXED_SPRITES;
+		render_bind_buffer(&vbo_data[first * SPRITE_QUAD_VERTICES], sizeof(packed_vertex));
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	render_bind_buffer(vbo_data, sizeof(packed_vertex));
+	return draws;
+}
+
+const render_path path_packed = {
+	"packed",
+	&program,
+	SPRITE_QUAD_VERTICES * 3 * sizeof(s16),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_PACKED_QUADS,
+	packed_init,
+	packed_exit,
+	packed_reserve,
+	packed_select,
+	packed_vertices,
+	packed_memory,
+	packed_bind,
+	packed_rebuild,
+	packed_retexture,
+	packed_move,
+	packed_flush,
+	packed_draw,
+};
@@ -0,0 +1,121 @@
+#include "render.h"
+#include "point_sprite.h"
+#include "gsprite_shbin.h"
+
+// One point per sprite, expanded into a quad by the geometry shader
+
+// Registers the vertex shader hands the geometry shader per point
+#define GSPRITE_STRIDE (5)
+
+static sprite_program program;
+static int uLoc_spritesize;
+static vbo_ring ring = {.sprite_bytes = sizeof(point_sprite)};
+static point_sprite *vbo_data;
+
+static bool points_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void points_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	render_bind_buffer(vbo_data, sizeof(point_sprite));
+}
+
+static void *points_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool points_init(int capacity)
+{
+	if (!sprite_program_load(&program, gsprite_shbin, gsprite_shbin_size))
+		return false;
+	shaderProgramSetGsh(&program.program, &program.dvlb->DVLE[1], GSPRITE_STRIDE);
+	uLoc_spritesize = shaderInstanceGetUniformLocation(program.program.vertexShader, "spritesize");
+
+	return points_reserve(capacity, 1);
+}
+
+static void points_exit(void)
+{
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t points_memory(void)
+{
+	return vbo_ring_memory(&ring);
+}
+
+static void points_bind(void)
+{
+	sprite_program_bind(&program);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_spritesize, SPRITE_WIDTH, SPRITE_HEIGHT, 0.0f, 0.0f);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=position
+	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 4); // v1=atlas rect
+
+	render_bind_buffer(vbo_data, sizeof(point_sprite));
+}
+
+static size_t points_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		point_sprite_set(&vbo_data[i], sprites->x[i], sprites->y[i], sprites->z[i], ts);
+	}
+	return count * sizeof(point_sprite);
+}
+
+static size_t points_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		point_sprite_uv(&vbo_data[i], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	return count * 4 * sizeof(float);
+}
+
+static size_t points_move(const sprite_store *sprites, int first, int count)
+{
+	point_sprites_emit(sprites, vbo_data, first, count);
+	return count * 3 * sizeof(float);
+}
+
+static size_t points_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int points_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	C3D_DrawArrays(GPU_GEOMETRY_PRIM, first, count);
+	return 1;
+}
+
+const render_path path_points = {
+	"gshader",
+	&program,
+	3 * sizeof(float),
+	1,
+	LAYOUT_POINTS,
+	points_init,
+	points_exit,
+	points_reserve,
+	points_select,
+	points_vertices,
+	points_memory,
+	points_bind,
+	points_rebuild,
+	points_retexture,
+	points_move,
+	points_flush,
+	points_draw,
+};
@@ -0,0 +1,166 @@
+#include "render.h"
+#include "split_vertex.h"
+#include "vshader_shbin.h"
+
+// Indexed quads with positions and texcoords in buffers of their own, so
+// moving sprites dirties and flushes only the positions
+
+static sprite_program program;
+static vbo_ring positions = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(split_position)};
+static vbo_ring uvs = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(split_uv)};
+static split_position *position_data;
+static split_uv *uv_data;
+// Indices for one batch of MAX_INDEXED_SPRITES sprites, shared by every batch
+static u16 *index_data;
+// Whether texcoords were written since the slot was selected; set by writers
+// that may run on several jobs at once
+static bool uvs_written;
+
+// One attribute from each buffer, unlike render_bind_buffer()
+static void bind_buffers(const split_position *position, const split_uv *uv)
+{
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, position, sizeof(split_position), 1, 0x0);
+	BufInfo_Add(bufInfo, uv, sizeof(split_uv), 1, 0x1);
+}
+
+static bool split_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve_pair(&positions, &uvs, capacity, slots))
+		return false;
+	position_data = positions.slots[positions.current];
+	uv_data = uvs.slots[uvs.current];
+	return true;
+}
+
+static void split_select(int slot)
+{
+	position_data = vbo_ring_select(&positions, slot);
+	uv_data = vbo_ring_select(&uvs, slot);
+	uvs_written = false;
+	bind_buffers(position_data, uv_data);
+}
+
+// Writers outside the path only ever move sprites
+static void *split_vertices(void)
+{
+	return position_data;
+}
+
+static bool split_init(int capacity)
+{
+	if (!sprite_program_load(&program, vshader_shbin, vshader_shbin_size))
+		return false;
+
+	index_data = linearAlloc(MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!index_data || !split_reserve(capacity, 1))
+		return false;
+
+	quad_indices(index_data, MAX_INDEXED_SPRITES);
+	GSPGPU_FlushDataCache(index_data, MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void split_exit(void)
+{
+	linearFree(index_data);
+	vbo_ring_free(&positions);
+	vbo_ring_free(&uvs);
+	position_data = NULL;
+	uv_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t split_memory(void)
+{
+	return vbo_ring_memory(&positions) + vbo_ring_memory(&uvs) +
+		MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16);
+}
+
+static void split_bind(void)
+{
+	sprite_program_bind(&program);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=position
+	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 2); // v1=texcoord
+
+	bind_buffers(position_data, uv_data);
+}
+
+static size_t split_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]);
+		move_split_quad(&position_data[i * SPRITE_QUAD_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i], SPRITE_WIDTH, SPRITE_HEIGHT);
+		uv_split_quad(&uv_data[i * SPRITE_QUAD_VERTICES], ts);
+	}
+	if (count > 0)
+		__atomic_store_n(&uvs_written, true, __ATOMIC_RELAXED);
+	return count * SPRITE_QUAD_VERTICES * (sizeof(split_position) + sizeof(split_uv));
+}
+
+static size_t split_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		uv_split_quad(&uv_data[i * SPRITE_QUAD_VERTICES], Tex3DS_GetSubTexture(t3x, sprites->t3x_index[i]));
+	if (count > 0)
+		__atomic_store_n(&uvs_written, true, __ATOMIC_RELAXED);
+	return count * SPRITE_QUAD_VERTICES * sizeof(split_uv);
+}
+
+static size_t split_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_split(sprites, position_data, first, count);
+	return count * SPRITE_QUAD_VERTICES * sizeof(split_position);
+}
+
+// Texcoords only when something wrote them this frame
+static size_t split_flush(int first, int count)
+{
+	size_t bytes = vbo_ring_flush(&positions, first, count);
+	if (uvs_written)
+		bytes += vbo_ring_flush(&uvs, first, count);
+	return bytes;
+}
+
+static int split_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	if (first == 0 && count <= MAX_INDEXED_SPRITES) {
+		C3D_DrawElements(GPU_TRIANGLES, count * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+		return 1;
+	}
+
+	// Rebased and batched like the indexed path, both buffers at once
+	int draws = 0;
+	for (int end = first + count; first < end; first += MAX_INDEXED_SPRITES, draws++) {
+		int batch = end - first < MAX_INDEXED_SPRITES ? end - first : MAX_INDEXED_SPRITES;
+		bind_buffers(&position_data[first * SPRITE_QUAD_VERTICES], &uv_data[first * SPRITE_QUAD_VERTICES]);
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	bind_buffers(position_data, uv_data);
+	return draws;
+}
+
+const render_path path_split = {
+	"split",
+	&program,
+	SPRITE_QUAD_VERTICES * sizeof(split_position),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_SPLIT_QUADS,
+	split_init,
+	split_exit,
+	split_reserve,
+	split_select,
+	split_vertices,
+	split_memory,
+	split_bind,
+	split_rebuild,
+	split_retexture,
+	split_move,
+	split_flush,
+	split_draw,
+};
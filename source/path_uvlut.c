@@ -0,0 +1,176 @@
+#include "render.h"
+#include "uvlut_vertex.h"
+#include "uvlut_shbin.h"
+
+// Indexed quads that look their texcoords up in a uniform table of the bound
+// atlas, so vertices never change with the atlas
+
+static sprite_program program;
+static int uLoc_spritesize, uLoc_uvs;
+static vbo_ring ring = {.sprite_bytes = SPRITE_QUAD_VERTICES * sizeof(uvlut_vertex)};
+static uvlut_vertex *vbo_data;
+// Indices for one batch of MAX_INDEXED_SPRITES sprites, shared by every batch
+static u16 *index_data;
+// The table of the atlas the next draw uses
+static uvlut_table table;
+static Tex3DS_Texture table_t3x;
+// The atlas whose table the uniforms hold, if any; other paths' programs
+// reuse the uniform space
+static Tex3DS_Texture uploaded_t3x;
+
+void path_uvlut_atlas(Tex3DS_Texture t3x)
+{
+	if (t3x == table_t3x)
+		return;
+	if (!uvlut_table_for(&table, t3x))
+		svcBreak(USERBREAK_PANIC);
+	table_t3x = t3x;
+}
+
+// Two attributes of their own layout, unlike render_bind_vertices()
+static void bind_buffer(const uvlut_vertex *data)
+{
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, data, sizeof(uvlut_vertex), 2, 0x10);
+}
+
+static bool uvlut_reserve(int capacity, int slots)
+{
+	if (!vbo_ring_reserve(&ring, capacity, slots))
+		return false;
+	vbo_data = ring.slots[ring.current];
+	return true;
+}
+
+static void uvlut_select(int slot)
+{
+	vbo_data = vbo_ring_select(&ring, slot);
+	bind_buffer(vbo_data);
+}
+
+static void *uvlut_vertices(void)
+{
+	return vbo_data;
+}
+
+static bool uvlut_init(int capacity)
+{
+	if (!sprite_program_load(&program, uvlut_shbin, uvlut_shbin_size))
+		return false;
+	uLoc_spritesize = shaderInstanceGetUniformLocation(program.program.vertexShader, "spritesize");
+	uLoc_uvs = shaderInstanceGetUniformLocation(program.program.vertexShader, "uvs");
+
+	index_data = linearAlloc(MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	if (!index_data || !uvlut_reserve(capacity, 1))
+		return false;
+
+	quad_indices(index_data, MAX_INDEXED_SPRITES);
+	GSPGPU_FlushDataCache(index_data, MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16));
+	return true;
+}
+
+static void uvlut_exit(void)
+{
+	linearFree(index_data);
+	vbo_ring_free(&ring);
+	vbo_data = NULL;
+	sprite_program_free(&program);
+}
+
+static size_t uvlut_memory(void)
+{
+	return vbo_ring_memory(&ring) +
+		MAX_INDEXED_SPRITES * SPRITE_QUAD_INDICES * sizeof(u16);
+}
+
+static void uvlut_bind(void)
+{
+	sprite_program_bind(&program);
+	uploaded_t3x = NULL;
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, uLoc_spritesize, SPRITE_WIDTH, SPRITE_HEIGHT, 0.0f, 0.0f);
+
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=top left
+	AttrInfo_AddLoader(attrInfo, 1, GPU_UNSIGNED_BYTE, 4); // v1=atlas entry and corner
+
+	bind_buffer(vbo_data);
+}
+
+static size_t uvlut_rebuild(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		add_uvlut_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], sprites->x[i], sprites->y[i], sprites->z[i], sprites->t3x_index[i]);
+	return count * SPRITE_QUAD_VERTICES * sizeof(uvlut_vertex);
+}
+
+// Entries are the same in every atlas; only sprites that never had theirs
+// written need it
+static size_t uvlut_retexture(const sprite_store *sprites, int first, int count, Tex3DS_Texture t3x)
+{
+	for (int i = first; i < first + count; i++)
+		entry_uvlut_quad(&vbo_data[i * SPRITE_QUAD_VERTICES], sprites->t3x_index[i]);
+	return count * SPRITE_QUAD_VERTICES * sizeof(u8);
+}
+
+static size_t uvlut_move(const sprite_store *sprites, int first, int count)
+{
+	sprite_store_emit_uvlut(sprites, vbo_data, first, count);
+	return count * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+}
+
+static size_t uvlut_flush(int first, int count)
+{
+	return vbo_ring_flush(&ring, first, count);
+}
+
+static int uvlut_draw(int first, int count, float iod)
+{
+	sprite_program_parallax(&program, iod);
+	// The whole atlas switch: one upload of the table
+	if (uploaded_t3x != table_t3x) {
+		C3D_FVec *uvs = C3D_FVUnifWritePtr(GPU_VERTEX_SHADER, uLoc_uvs, UVLUT_ENTRIES);
+		for (int i = 0; i < UVLUT_ENTRIES; i++) {
+			uvs[i].x = table.rect[i][0];
+			uvs[i].y = table.rect[i][1];
+			uvs[i].z = table.rect[i][2];
+			uvs[i].w = table.rect[i][3];
+		}
+		uploaded_t3x = table_t3x;
+	}
+	if (first == 0 && count <= MAX_INDEXED_SPRITES) {
+		C3D_DrawElements(GPU_TRIANGLES, count * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+		return 1;
+	}
+
+	// Rebased and batched like the indexed path
+	int draws = 0;
+	for (int end = first + count; first < end; first += MAX_INDEXED_SPRITES, draws++) {
+		int batch = end - first < MAX_INDEXED_SPRITES ? end - first : MAX_INDEXED_SPRITES;
+		bind_buffer(&vbo_data[first * SPRITE_QUAD_VERTICES]);
+		C3D_DrawElements(GPU_TRIANGLES, batch * SPRITE_QUAD_INDICES, C3D_UNSIGNED_SHORT, index_data);
+	}
+	bind_buffer(vbo_data);
+	return draws;
+}
+
+const render_path path_uvlut = {
+	"uv table",
+	&program,
+	SPRITE_QUAD_VERTICES * 3 * sizeof(float),
+	SPRITE_QUAD_INDICES,
+	LAYOUT_UVLUT_QUADS,
+	uvlut_init,
+	uvlut_exit,
+	uvlut_reserve,
+	uvlut_select,
+	uvlut_vertices,
+	uvlut_memory,
+	uvlut_bind,
+	uvlut_rebuild,
+	uvlut_retexture,
+	uvlut_move,
+	uvlut_flush,
+	uvlut_draw,
+};
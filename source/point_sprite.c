@@ -0,0 +1,41 @@
+#include "point_sprite.h"
+
+void point_sprite_set(point_sprite *dest, float x, float y, float z, const Tex3DS_SubTexture *ts) {
+	dest->x = x;
+	dest->y = y;
+	dest->z = z;
+	point_sprite_uv(dest, ts);
+}
+
+void point_sprite_uv(point_sprite *dest, const Tex3DS_SubTexture *ts) {
+	dest->left = ts->left;
+	dest->top = ts->top;
+	dest->right = ts->right;
+	dest->bottom = ts->bottom;
+}
+
+void point_sprites_emit(const sprite_store *store, point_sprite *points, int first, int count) {
+	for (int i = first; i < first + count; i++) {
+		points[i].x = store->x[i];
+		points[i].y = store->y[i];
+		points[i].z = store->z[i];
+	}
+}
+
+void point_sprite_expand(const point_sprite *p, float width, float height, vertex *dest) {
+	// Corners in the order the shader computes them
+	vertex corners[] = {
+		{p->x, p->y, p->z, p->left, p->top},
+		{p->x + width, p->y, p->z, p->right, p->top},
+		{p->x, p->y + height, p->z, p->left, p->bottom},
+		{p->x + width, p->y + height, p->z, p->right, p->bottom},
+	};
+
+	// Two independent triangles: (0, 1, 2) and (2, 1, 3)
+	dest[0] = corners[0];
+	dest[1] = corners[1];
+	dest[2] = corners[2];
+	dest[3] = corners[2];
+	dest[4] = corners[1];
+	dest[5] = corners[3];
+}
@@ -0,0 +1,80 @@
+#include "profile.h"
+
+#ifndef __3DS__
+#include <time.h>
+#endif
+
+static profile_zone ring[PROFILE_RING_SIZE];
+static u32 ring_head;
+
+// Small per-thread ids for the trace, handed out in order of first use
+static u32 next_thread;
+static __thread u32 thread_id;
+
+#ifdef __3DS__
+u64 profile_ticks(void) {
+	return svcGetSystemTick();
+}
+
+double profile_ticks_to_us(u64 ticks) {
+	return ticks * (1000000.0 / SYSCLOCK_ARM11);
+}
+#else
+u64 profile_ticks(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+double profile_ticks_to_us(u64 ticks) {
+	return ticks / 1000.0;
+}
+#endif
+
+void profile_scope_end(profile_scope *scope) {
+	u64 end = profile_ticks();
+	if (!thread_id)
+		thread_id = __atomic_add_fetch(&next_thread, 1, __ATOMIC_RELAXED);
+
+	u32 slot = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED) & (PROFILE_RING_SIZE - 1);
+	ring[slot] = (profile_zone){scope->name, scope->start, end, thread_id};
+}
+
+u32 profile_count(void) {
+	return __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+}
+
+// The zone recorded index zones before the count-th one
+static const profile_zone *zone_at(u32 count, u32 index) {
+	return &ring[(count - 1 - index) & (PROFILE_RING_SIZE - 1)];
+}
+
+bool profile_get(u32 index, profile_zone *zone) {
+	u32 count = profile_count();
+	if (index >= count || index >= PROFILE_RING_SIZE)
+		return false;
+	*zone = *zone_at(count, index);
+	return true;
+}
+
+void profile_write_trace(FILE *f) {
+	u32 count = profile_count();
+	u32 kept = count < PROFILE_RING_SIZE ? count : PROFILE_RING_SIZE;
+
+	// Timestamps relative to the oldest zone kept, so they stay readable
+	u64 origin = 0;
+	for (u32 i = 0; i < kept; i++) {
+		u64 start = zone_at(count, i)->start;
+		if (i == 0 || start < origin)
+			origin = start;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (u32 i = kept; i-- > 0;) {
+		const profile_zone *zone = zone_at(count, i);
+		fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			zone->name, (unsigned)zone->thread, profile_ticks_to_us(zone->start - origin),
+			profile_ticks_to_us(zone->end - zone->start), i ? "," : "");
+	}
+	fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+}
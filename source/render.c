@@ -0,0 +1,165 @@
+#include <string.h>
+#include "render.h"
+
+static C3D_Mtx projection;
+
+void render_set_projection(const C3D_Mtx *mtx)
+{
+	projection = *mtx;
+}
+
+bool sprite_program_load(sprite_program *sp, const u8 *shbin, u32 shbin_size)
+{
+	sp->dvlb = DVLB_ParseFile((u32 *)shbin, shbin_size);
+	if (!sp->dvlb)
+		return false;
+	shaderProgramInit(&sp->program);
+	shaderProgramSetVsh(&sp->program, &sp->dvlb->DVLE[0]);
+
+	// Get the location of the uniforms
+	sp->uLoc_projection = shaderInstanceGetUniformLocation(sp->program.vertexShader, "projection");
+	sp->uLoc_tint = shaderInstanceGetUniformLocation(sp->program.vertexShader, "tint");
+	sp->uLoc_depthinfo = shaderInstanceGetUniformLocation(sp->program.vertexShader, "depthinfo");
+	return true;
+}
+
+void sprite_program_free(sprite_program *sp)
+{
+	shaderProgramFree(&sp->program);
+	DVLB_Free(sp->dvlb);
+}
+
+void sprite_program_bind(sprite_program *sp)
+{
+	C3D_BindProgram(&sp->program);
+
+	// Programs lay out their uniforms differently, so these are set again
+	// whenever another program is bound, but not for every draw
+	C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, sp->uLoc_projection, &projection);
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, sp->uLoc_tint, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void sprite_program_parallax(const sprite_program *sp, float iod)
+{
+	C3D_FVUnifSet(GPU_VERTEX_SHADER, sp->uLoc_depthinfo, iod, MIN_DEPTH, MAX_DEPTH, DEEPNESS);
+}
+
+void render_bind_vertices(const vertex *vbo)
+{
+	// Configure attributes for use with the vertex shader
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3); // v0=position
+	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 2); // v1=texcoord
+
+	// Configure buffers
+	render_bind_buffer(vbo, sizeof(vertex));
+}
+
+void render_bind_buffer(const void *data, size_t stride)
+{
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, data, stride, 2, 0x10);
+}
+
+// A ring's buffers grown to at least slots of capacity sprites, allocated
+// but not yet swapped in
+typedef struct {
+	void *slots[VBO_RING_MAX];
+	int num_slots;
+	int capacity;
+} vbo_ring_growth;
+
+static bool vbo_ring_grow(const vbo_ring *ring, int capacity, int slots, vbo_ring_growth *growth)
+{
+	memset(growth, 0, sizeof(*growth));
+	if (capacity <= ring->capacity && slots <= ring->num_slots)
+		return true;
+	if (capacity < ring->capacity)
+		capacity = ring->capacity;
+	if (slots < ring->num_slots)
+		slots = ring->num_slots;
+
+	for (int i = 0; i < slots; i++) {
+		growth->slots[i] = linearAlloc(capacity * ring->sprite_bytes);
+		if (!growth->slots[i]) {
+			while (i-- > 0)
+				linearFree(growth->slots[i]);
+			return false;
+		}
+	}
+	growth->num_slots = slots;
+	growth->capacity = capacity;
+	return true;
+}
+
+static void vbo_ring_discard(vbo_ring_growth *growth)
+{
+	for (int i = 0; i < growth->num_slots; i++)
+		linearFree(growth->slots[i]);
+}
+
+// Free the old buffers for the grown ones, if there are any
+static void vbo_ring_commit(vbo_ring *ring, const vbo_ring_growth *growth)
+{
+	if (!growth->num_slots)
+		return;
+	for (int i = 0; i < ring->num_slots; i++)
+		linearFree(ring->slots[i]);
+	memcpy(ring->slots, growth->slots, sizeof(growth->slots));
+	ring->num_slots = growth->num_slots;
+	ring->capacity = growth->capacity;
+	ring->current = 0;
+}
+
+bool vbo_ring_reserve(vbo_ring *ring, int capacity, int slots)
+{
+	vbo_ring_growth growth;
+	if (!vbo_ring_grow(ring, capacity, slots, &growth))
+		return false;
+	vbo_ring_commit(ring, &growth);
+	return true;
+}
+
+bool vbo_ring_reserve_pair(vbo_ring *a, vbo_ring *b, int capacity, int slots)
+{
+	vbo_ring_growth growth_a, growth_b;
+	if (!vbo_ring_grow(a, capacity, slots, &growth_a))
+		return false;
+	if (!vbo_ring_grow(b, capacity, slots, &growth_b)) {
+		vbo_ring_discard(&growth_a);
+		return false;
+	}
+	vbo_ring_commit(a, &growth_a);
+	vbo_ring_commit(b, &growth_b);
+	return true;
+}
+
+void vbo_ring_free(vbo_ring *ring)
+{
+	for (int i = 0; i < ring->num_slots; i++)
+		linearFree(ring->slots[i]);
+	memset(ring->slots, 0, sizeof(ring->slots));
+	ring->num_slots = 0;
+	ring->capacity = 0;
+	ring->current = 0;
+}
+
+void *vbo_ring_select(vbo_ring *ring, int slot)
+{
+	ring->current = slot;
+	return ring->slots[slot];
+}
+
+size_t vbo_ring_memory(const vbo_ring *ring)
+{
+	return ring->num_slots * ring->capacity * ring->sprite_bytes;
+}
+
+size_t vbo_ring_flush(const vbo_ring *ring, int first, int count)
+{
+	size_t bytes = count * ring->sprite_bytes;
+	GSPGPU_FlushDataCache((u8 *)ring->slots[ring->current] + first * ring->sprite_bytes, bytes);
+	return bytes;
+}
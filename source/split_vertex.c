@@ -0,0 +1,32 @@
+#include "split_vertex.h"
+
+void move_split_quad(split_position *dest, float x, float y, float z, float width, float height) {
+	dest[0].x = x;
+	dest[0].y = y;
+	dest[0].z = z;
+	dest[1].x = x + width;
+	dest[1].y = y;
+	dest[1].z = z;
+	dest[2].x = x;
+	dest[2].y = y + height;
+	dest[2].z = z;
+	dest[3].x = x + width;
+	dest[3].y = y + height;
+	dest[3].z = z;
+}
+
+void uv_split_quad(split_uv *dest, const Tex3DS_SubTexture *ts) {
+	dest[0].u = ts->left;
+	dest[0].v = ts->top;
+	dest[1].u = ts->right;
+	dest[1].v = ts->top;
+	dest[2].u = ts->left;
+	dest[2].v = ts->bottom;
+	dest[3].u = ts->right;
+	dest[3].v = ts->bottom;
+}
+
+void sprite_store_emit_split(const sprite_store *store, split_position *positions, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_split_quad(&positions[i * SPRITE_QUAD_VERTICES], store->x[i], store->y[i], store->z[i], SPRITE_WIDTH, SPRITE_HEIGHT);
+}
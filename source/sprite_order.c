@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sprite_order.h"
+
+// 0 at MAX_DEPTH, the front, up to 0xFFFF at MIN_DEPTH
+static u16 depth_key(const sprite_store *store, int i) {
+	float t = (MAX_DEPTH - store->z[i]) * (65535.0f / DEEPNESS);
+	if (t < 0.0f)
+		t = 0.0f;
+	if (t > 65535.0f)
+		t = 65535.0f;
+	return (u16)t;
+}
+
+// Sixteenths of a pixel from 2048 above the screen, which covers every arena
+static u16 row_key(const sprite_store *store, int i) {
+	float t = (store->y[i] + 2048.0f) * 16.0f;
+	if (t < 0.0f)
+		t = 0.0f;
+	if (t > 65535.0f)
+		t = 65535.0f;
+	return (u16)t;
+}
+
+const sprite_order_key sprite_order_depth = {"depth", depth_key, false};
+const sprite_order_key sprite_order_rows = {"rows", row_key, true};
+
+void sprite_order_free(sprite_order *o) {
+	free(o->order);
+	free(o->keys);
+	free(o->keys_temp);
+	free(o->order_temp);
+	memset(o, 0, sizeof(*o));
+}
+
+// Move the first count elements of *array into a new array of capacity
+static bool grow_array(void **array, int count, int capacity, size_t size) {
+	void *grown = malloc(capacity * size);
+	if (!grown)
+		return false;
+	if (count)
+		memcpy(grown, *array, count * size);
+	free(*array);
+	*array = grown;
+	return true;
+}
+
+bool sprite_order_reserve(sprite_order *o, int capacity) {
+	if (capacity <= o->capacity)
+		return true;
+	int count = o->capacity;
+	if (!grow_array((void **)&o->order, count, capacity, sizeof(int)) ||
+		!grow_array((void **)&o->keys, count, capacity, sizeof(u16)) ||
+		!grow_array((void **)&o->keys_temp, 0, capacity, sizeof(u16)) ||
+		!grow_array((void **)&o->order_temp, 0, capacity, sizeof(int)))
+		return false;
+	o->capacity = capacity;
+	return true;
+}
+
+void sprite_order_sort(sprite_order *o, const sprite_store *store, int first, int count) {
+	// Passes alternate between the range and the scratch buffers, so an even
+	// number of them leaves the result in the range
+	u16 *keys = o->keys + first, *keys_out = o->keys_temp;
+	int *order = o->order + first, *order_out = o->order_temp;
+	for (int i = 0; i < count; i++) {
+		keys[i] = o->key->key(store, first + i);
+		order[i] = first + i;
+	}
+
+	// Least significant byte first; each pass is stable, so ties keep their
+	// store order
+	for (int shift = 0; shift < SPRITE_ORDER_BITS; shift += 8) {
+		int offsets[256] = {0};
+		for (int i = 0; i < count; i++)
+			offsets[(keys[i] >> shift) & 0xFF]++;
+		for (int b = 0, sum = 0; b < 256; b++) {
+			int n = offsets[b];
+			offsets[b] = sum;
+			sum += n;
+		}
+		for (int i = 0; i < count; i++) {
+			int j = offsets[(keys[i] >> shift) & 0xFF]++;
+			keys_out[j] = keys[i];
+			order_out[j] = order[i];
+		}
+
+		u16 *k = keys;
+		keys = keys_out;
+		keys_out = k;
+		int *p = order;
+		order = order_out;
+		order_out = p;
+	}
+}
+
+// Insertion sort over order[first, first + count) that stops once it has
+// made more than budget swaps. Returns the swaps made.
+static int insertion_sort(sprite_order *o, int first, int count, int budget) {
+	u16 *keys = o->keys;
+	int *order = o->order;
+	int swaps = 0;
+	for (int k = first + 1; k < first + count && swaps <= budget; k++) {
+		u16 key = keys[k];
+		int i = order[k];
+		int j = k;
+		for (; j > first && keys[j - 1] > key; j--) {
+			keys[j] = keys[j - 1];
+			order[j] = order[j - 1];
+		}
+		keys[j] = key;
+		order[j] = i;
+		swaps += k - j;
+	}
+	return swaps;
+}
+
+// Fix the order after keys[first, first + count) changed
+static int fix_order(sprite_order *o, const sprite_store *store, int first, int count) {
+	int swaps = insertion_sort(o, first, count, count * SPRITE_ORDER_REPAIR_BUDGET);
+	if (swaps > count * SPRITE_ORDER_REPAIR_BUDGET) {
+		sprite_order_sort(o, store, first, count);
+		o->full_sorts++;
+	}
+	o->swaps += swaps;
+	return swaps;
+}
+
+int sprite_order_repair(sprite_order *o, const sprite_store *store, int first, int count) {
+	for (int k = first; k < first + count; k++)
+		o->keys[k] = o->key->key(store, o->order[k]);
+	return fix_order(o, store, first, count);
+}
+
+int sprite_order_grow(sprite_order *o, const sprite_store *store, int old_first, int old_size, int first, int size) {
+	memmove(o->keys + first, o->keys + old_first, old_size * sizeof(u16));
+	memmove(o->order + first, o->order + old_first, old_size * sizeof(int));
+	for (int k = first; k < first + old_size; k++)
+		o->order[k] += first - old_first;
+
+	// The new sprites are a range of their own, so sort them on their own and
+	// merge the two runs from the back. Ties keep old sprites first.
+	int added = size - old_size;
+	sprite_order_sort(o, store, first + old_size, added);
+	memcpy(o->keys_temp, o->keys + first + old_size, added * sizeof(u16));
+	memcpy(o->order_temp, o->order + first + old_size, added * sizeof(int));
+	int moved = 0;
+	for (int a = old_size - 1, b = added - 1, k = first + size - 1; b >= 0; k--) {
+		if (a >= 0 && o->keys[first + a] > o->keys_temp[b]) {
+			o->keys[k] = o->keys[first + a];
+			o->order[k] = o->order[first + a];
+			a--;
+			moved++;
+		} else {
+			o->keys[k] = o->keys_temp[b];
+			o->order[k] = o->order_temp[b];
+			b--;
+		}
+	}
+	o->swaps += moved;
+	return moved;
+}
+
+int sprite_order_gather(const sprite_order *o, const sprite_store *store, int first, int size, int visible,
+	bool cull, float parallax, sprite_store *view, int dest) {
+	int copied = 0;
+	for (int k = first; k < first + size; k++) {
+		int i = o->order[k];
+		if (i >= first + visible || (cull && !sprite_store_on_screen(store, i, parallax)))
+			continue;
+		sprite_store_gather(store, i, view, dest + copied++);
+	}
+	return copied;
+}
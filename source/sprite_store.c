@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sprite_store.h"
+
+static void *alloc_array(int count, size_t size) {
+	size_t bytes = (count * size + SPRITE_STORE_ALIGN - 1) & ~(size_t)(SPRITE_STORE_ALIGN - 1);
+	void *mem = aligned_alloc(SPRITE_STORE_ALIGN, bytes);
+	if (mem)
+		memset(mem, 0, bytes);
+	return mem;
+}
+
+bool sprite_store_init(sprite_store *store, int capacity) {
+	memset(store, 0, sizeof(*store));
+	store->x = alloc_array(capacity, sizeof(float));
+	store->y = alloc_array(capacity, sizeof(float));
+	store->velocity_x = alloc_array(capacity, sizeof(float));
+	store->velocity_y = alloc_array(capacity, sizeof(float));
+	store->z = alloc_array(capacity, sizeof(float));
+	store->t3x_index = alloc_array(capacity, sizeof(u16));
+	store->atlas = alloc_array(capacity, sizeof(u8));
+	store->capacity = capacity;
+
+	if (!store->x || !store->y || !store->velocity_x || !store->velocity_y || !store->z || !store->t3x_index || !store->atlas) {
+		sprite_store_free(store);
+		return false;
+	}
+	return true;
+}
+
+// Move the first count elements of *array into a new array of capacity
+static bool grow_array(void **array, int count, int capacity, size_t size) {
+	void *grown = alloc_array(capacity, size);
+	if (!grown)
+		return false;
+	memcpy(grown, *array, count * size);
+	free(*array);
+	*array = grown;
+	return true;
+}
+
+bool sprite_store_reserve(sprite_store *store, int capacity) {
+	if (capacity <= store->capacity)
+		return true;
+	capacity = (capacity + SPRITE_POOL_CHUNK - 1) / SPRITE_POOL_CHUNK * SPRITE_POOL_CHUNK;
+
+	// Each array grows on its own, so a failure part way leaves the store
+	// consistent at its old capacity
+	int count = store->capacity;
+	if (!grow_array((void **)&store->x, count, capacity, sizeof(float)) ||
+		!grow_array((void **)&store->y, count, capacity, sizeof(float)) ||
+		!grow_array((void **)&store->velocity_x, count, capacity, sizeof(float)) ||
+		!grow_array((void **)&store->velocity_y, count, capacity, sizeof(float)) ||
+		!grow_array((void **)&store->z, count, capacity, sizeof(float)) ||
+		!grow_array((void **)&store->t3x_index, count, capacity, sizeof(u16)) ||
+		!grow_array((void **)&store->atlas, count, capacity, sizeof(u8)))
+		return false;
+	store->capacity = capacity;
+	return true;
+}
+
+size_t sprite_store_memory(const sprite_store *store) {
+	return (size_t)store->capacity * (5 * sizeof(float) + sizeof(u16) + sizeof(u8));
+}
+
+void sprite_store_free(sprite_store *store) {
+	free(store->x);
+	free(store->y);
+	free(store->velocity_x);
+	free(store->velocity_y);
+	free(store->z);
+	free(store->t3x_index);
+	free(store->atlas);
+	memset(store, 0, sizeof(*store));
+}
+
+void sprite_store_set(sprite_store *store, int i, const spriteinfo *s) {
+	store->x[i] = s->x;
+	store->y[i] = s->y;
+	store->z[i] = s->z;
+	store->velocity_x[i] = s->velocity_x;
+	store->velocity_y[i] = s->velocity_y;
+	store->t3x_index[i] = s->t3x_index;
+	store->atlas[i] = s->atlas;
+}
+
+spriteinfo sprite_store_get(const sprite_store *store, int i) {
+	spriteinfo s = {store->x[i], store->y[i], store->z[i], store->velocity_x[i], store->velocity_y[i], store->t3x_index[i], store->atlas[i]};
+	return s;
+}
+
+static void permute_array(void *array, size_t size, const int *dest, int count, void *scratch) {
+	for (int i = 0; i < count; i++)
+		memcpy((u8 *)scratch + dest[i] * size, (u8 *)array + i * size, size);
+	memcpy(array, scratch, count * size);
+}
+
+void sprite_store_permute(sprite_store *store, const int *dest, int count, void *scratch) {
+	permute_array(store->x, sizeof(float), dest, count, scratch);
+	permute_array(store->y, sizeof(float), dest, count, scratch);
+	permute_array(store->velocity_x, sizeof(float), dest, count, scratch);
+	permute_array(store->velocity_y, sizeof(float), dest, count, scratch);
+	permute_array(store->z, sizeof(float), dest, count, scratch);
+	permute_array(store->t3x_index, sizeof(u16), dest, count, scratch);
+	permute_array(store->atlas, sizeof(u8), dest, count, scratch);
+}
+
+// One axis of the bounce: same arithmetic as sprites_update(), but the flip is
+// a select instead of a branch
+static inline void advance_axis(float *restrict pos, float *restrict velocity, int count, float delta, float low, float high) {
+	for (int i = 0; i < count; i++) {
+		float v = velocity[i];
+		float p = pos[i] + v * delta;
+		pos[i] = p;
+		velocity[i] = (p < low) | (p > high) ? -v : v;
+	}
+}
+
+void sprite_store_update(sprite_store *store, int first, int count, float delta) {
+	delta *= 6.0 / 100.0;
+	float m = store->margin;
+	advance_axis(store->x + first, store->velocity_x + first, count, delta, -m, (float)GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH + m);
+	advance_axis(store->y + first, store->velocity_y + first, count, delta, -m, (float)GSP_SCREEN_WIDTH - SPRITE_HEIGHT + m);
+}
+
+// Map pos from [-from, limit + from] onto [-to, limit + to]
+static void rescale_axis(float *pos, int count, float limit, float from, float to) {
+	float scale = (limit + 2.0f * to) / (limit + 2.0f * from);
+	for (int i = 0; i < count; i++)
+		pos[i] = (pos[i] + from) * scale - to;
+}
+
+void sprite_store_set_arena(sprite_store *store, int count, float margin) {
+	rescale_axis(store->x, count, (float)GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH, store->margin, margin);
+	rescale_axis(store->y, count, (float)GSP_SCREEN_WIDTH - SPRITE_HEIGHT, store->margin, margin);
+	store->margin = margin;
+}
+
+int sprite_store_cull(const sprite_store *store, int first, int count, float parallax, sprite_store *view, int dest) {
+	int copied = 0;
+	for (int i = first; i < first + count; i++) {
+		if (!sprite_store_on_screen(store, i, parallax))
+			continue;
+		sprite_store_gather(store, i, view, dest + copied++);
+	}
+	return copied;
+}
+
+static inline bool moving(const sprite_store *store, int i) {
+	return store->velocity_x[i] != 0.0f || store->velocity_y[i] != 0.0f;
+}
+
+int sprite_store_next_moving(const sprite_store *store, int *first, int end) {
+	int i = *first;
+	while (i < end && !moving(store, i))
+		i++;
+	*first = i;
+	while (i < end && moving(store, i))
+		i++;
+	return i - *first;
+}
+
+void sprite_store_emit(const sprite_store *store, vertex *vbo, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_rect(&vbo[i * SPRITE_VERTICES], store->x[i], store->y[i], store->z[i], SPRITE_WIDTH, SPRITE_HEIGHT);
+}
+
+void sprite_store_emit_quads(const sprite_store *store, vertex *vbo, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_quad(&vbo[i * SPRITE_QUAD_VERTICES], store->x[i], store->y[i], store->z[i], SPRITE_WIDTH, SPRITE_HEIGHT);
+}
@@ -0,0 +1,247 @@
+#include "sprite_world.h"
+#include "flecs_os.h"
+#include "point_sprite.h"
+#include "packed_vertex.h"
+#include "analytic_vertex.h"
+#include "uvlut_vertex.h"
+#include "split_vertex.h"
+#include "instanced_vertex.h"
+
+ECS_COMPONENT_DECLARE(Position);
+ECS_COMPONENT_DECLARE(Velocity);
+ECS_COMPONENT_DECLARE(Depth);
+ECS_COMPONENT_DECLARE(AtlasIndex);
+
+// Rows [*lo, *hi) of the table slice the iterator covers that are in range r,
+// as indices into the slice. False if there are none.
+static inline bool range_rows(const ecs_iter_t *it, const sprite_world_frame *frame, int r, int *lo, int *hi) {
+	int first = frame->first[r], end = first + frame->count[r];
+	*lo = (first > it->offset ? first : it->offset) - it->offset;
+	*hi = (end < it->offset + it->count ? end : it->offset + it->count) - it->offset;
+	return *lo < *hi;
+}
+
+static void Move(ecs_iter_t *it) {
+	const sprite_world_frame *frame = it->ctx;
+	if (!frame->delta)
+		return;
+	Position *p = ecs_field(it, Position, 1);
+	const Velocity *v = ecs_field(it, Velocity, 2);
+	// Rounded like sprite_store_update() scales it
+	float delta = frame->delta * (6.0 / 100.0);
+	int lo, hi;
+	for (int r = 0; r < frame->num_ranges; r++) {
+		if (!range_rows(it, frame, r, &lo, &hi))
+			continue;
+		for (int k = lo; k < hi; k++) {
+			p[k].x = p[k].x + v[k].x * delta;
+			p[k].y = p[k].y + v[k].y * delta;
+		}
+	}
+}
+
+static void Bounce(ecs_iter_t *it) {
+	const sprite_world_frame *frame = it->ctx;
+	if (!frame->delta)
+		return;
+	const Position *p = ecs_field(it, Position, 1);
+	Velocity *v = ecs_field(it, Velocity, 2);
+	int lo, hi;
+	for (int r = 0; r < frame->num_ranges; r++) {
+		if (!range_rows(it, frame, r, &lo, &hi))
+			continue;
+		for (int k = lo; k < hi; k++) {
+			v[k].x = (p[k].x < frame->low_x) | (p[k].x > frame->high_x) ? -v[k].x : v[k].x;
+			v[k].y = (p[k].y < frame->low_y) | (p[k].y > frame->high_y) ? -v[k].y : v[k].y;
+		}
+	}
+}
+
+static void Emit(ecs_iter_t *it) {
+	sprite_world_frame *frame = it->ctx;
+	if (!frame->vbo)
+		return;
+	size_t bytes = 0;
+	const Position *p = ecs_field(it, Position, 1);
+	const Depth *d = ecs_field(it, Depth, 2);
+	int lo, hi;
+	for (int r = 0; r < frame->num_ranges; r++) {
+		if (!range_rows(it, frame, r, &lo, &hi))
+			continue;
+		// Table rows are store indices, and so vertex buffer indices
+		int base = it->offset;
+		switch (frame->layout) {
+		case LAYOUT_RECTS:
+			for (int k = lo; k < hi; k++)
+				move_rect((vertex *)frame->vbo + (base + k) * SPRITE_VERTICES, p[k].x, p[k].y, d[k].z, SPRITE_WIDTH, SPRITE_HEIGHT);
+			bytes += (hi - lo) * SPRITE_VERTICES * 3 * sizeof(float);
+			break;
+		case LAYOUT_QUADS:
+			for (int k = lo; k < hi; k++)
+				move_quad((vertex *)frame->vbo + (base + k) * SPRITE_QUAD_VERTICES, p[k].x, p[k].y, d[k].z, SPRITE_WIDTH, SPRITE_HEIGHT);
+			bytes += (hi - lo) * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+			break;
+		case LAYOUT_POINTS:
+			for (int k = lo; k < hi; k++) {
+				point_sprite *ps = (point_sprite *)frame->vbo + base + k;
+				ps->x = p[k].x;
+				ps->y = p[k].y;
+				ps->z = d[k].z;
+			}
+			bytes += (hi - lo) * 3 * sizeof(float);
+			break;
+		case LAYOUT_PACKED_QUADS:
+			for (int k = lo; k < hi; k++)
+				move_packed_quad((packed_vertex *)frame->vbo + (base + k) * SPRITE_QUAD_VERTICES, p[k].x, p[k].y, d[k].z, SPRITE_WIDTH, SPRITE_HEIGHT);
+			bytes += (hi - lo) * SPRITE_QUAD_VERTICES * 3 * sizeof(s16);
+			break;
+		case LAYOUT_ANALYTIC_QUADS:
+			for (int k = lo; k < hi; k++)
+				move_analytic_quad((analytic_vertex *)frame->vbo + (base + k) * SPRITE_QUAD_VERTICES, p[k].x, p[k].y, d[k].z);
+			bytes += (hi - lo) * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+			break;
+		case LAYOUT_UVLUT_QUADS:
+			for (int k = lo; k < hi; k++)
+				move_uvlut_quad((uvlut_vertex *)frame->vbo + (base + k) * SPRITE_QUAD_VERTICES, p[k].x, p[k].y, d[k].z);
+			bytes += (hi - lo) * SPRITE_QUAD_VERTICES * 3 * sizeof(float);
+			break;
+		case LAYOUT_SPLIT_QUADS:
+			for (int k = lo; k < hi; k++)
+				move_split_quad((split_position *)frame->vbo + (base + k) * SPRITE_QUAD_VERTICES, p[k].x, p[k].y, d[k].z, SPRITE_WIDTH, SPRITE_HEIGHT);
+			bytes += (hi - lo) * SPRITE_QUAD_VERTICES * sizeof(split_position);
+			break;
+		case LAYOUT_INSTANCES:
+			for (int k = lo; k < hi; k++)
+				move_instance((sprite_instance *)frame->vbo + base + k, p[k].x, p[k].y, d[k].z);
+			bytes += (hi - lo) * 3 * sizeof(float);
+			break;
+		}
+	}
+	__atomic_fetch_add(&frame->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+// Copies every row in from the store passed as the param
+static void Load(ecs_iter_t *it) {
+	const sprite_store *store = it->param;
+	Position *p = ecs_field(it, Position, 1);
+	Velocity *v = ecs_field(it, Velocity, 2);
+	Depth *d = ecs_field(it, Depth, 3);
+	AtlasIndex *a = ecs_field(it, AtlasIndex, 4);
+	for (int k = 0; k < it->count; k++) {
+		int i = it->offset + k;
+		p[k] = (Position){store->x[i], store->y[i]};
+		v[k] = (Velocity){store->velocity_x[i], store->velocity_y[i]};
+		d[k] = (Depth){store->z[i]};
+		a[k] = (AtlasIndex){store->t3x_index[i], store->atlas[i]};
+	}
+}
+
+static void Save(ecs_iter_t *it) {
+	const sprite_world_frame *frame = it->ctx;
+	if (!frame->delta)
+		return;
+	const Position *p = ecs_field(it, Position, 1);
+	const Velocity *v = ecs_field(it, Velocity, 2);
+	sprite_store *store = frame->store;
+	int lo, hi;
+	for (int r = 0; r < frame->num_ranges; r++) {
+		if (!range_rows(it, frame, r, &lo, &hi))
+			continue;
+		for (int k = lo; k < hi; k++) {
+			int i = it->offset + k;
+			store->x[i] = p[k].x;
+			store->y[i] = p[k].y;
+			store->velocity_x[i] = v[k].x;
+			store->velocity_y[i] = v[k].y;
+		}
+	}
+}
+
+// A system over the world's frame in phase, or one that only runs when asked
+// to with ecs_run() if phase is 0. Terms are spelled out, since the query
+// parser addon is not built. Instanced, so worker slices keep their table
+// offset in it->offset rather than resetting it to 0.
+#define ADD_SYSTEM(w, callback_, phase, ...) \
+	ecs_system((w)->world, { \
+		.entity = ecs_entity((w)->world, { \
+			.name = #callback_, \
+			.add = {(phase) ? ecs_dependson(phase) : 0, (phase)}, \
+		}), \
+		.query.filter.terms = {__VA_ARGS__}, \
+		.query.filter.instanced = true, \
+		.callback = callback_, \
+		.ctx = &(w)->frame, \
+		.multi_threaded = (phase) != 0, \
+	})
+
+bool sprite_world_init(sprite_world *w) {
+	flecs_os_init();
+	w->world = ecs_init();
+	if (!w->world)
+		return false;
+	ECS_COMPONENT_DEFINE(w->world, Position);
+	ECS_COMPONENT_DEFINE(w->world, Velocity);
+	ECS_COMPONENT_DEFINE(w->world, Depth);
+	ECS_COMPONENT_DEFINE(w->world, AtlasIndex);
+
+	// Systems in a phase run in the order they were added
+	bool ok = ADD_SYSTEM(w, Move, EcsOnUpdate, {ecs_id(Position)}, {ecs_id(Velocity), .inout = EcsIn}) &&
+		ADD_SYSTEM(w, Bounce, EcsOnUpdate, {ecs_id(Position), .inout = EcsIn}, {ecs_id(Velocity)}) &&
+		ADD_SYSTEM(w, Save, EcsPostUpdate, {ecs_id(Position), .inout = EcsIn}, {ecs_id(Velocity), .inout = EcsIn}) &&
+		ADD_SYSTEM(w, Emit, EcsOnStore, {ecs_id(Position), .inout = EcsIn}, {ecs_id(Depth), .inout = EcsIn});
+	w->load = ADD_SYSTEM(w, Load, 0, {ecs_id(Position), .inout = EcsOut}, {ecs_id(Velocity), .inout = EcsOut},
+		{ecs_id(Depth), .inout = EcsOut}, {ecs_id(AtlasIndex), .inout = EcsOut});
+	w->count = 0;
+	w->threads = 1;
+	return ok && w->load;
+}
+
+void sprite_world_set_threads(sprite_world *w, int threads) {
+	if (threads == w->threads)
+		return;
+	ecs_set_threads(w->world, threads);
+	w->threads = threads;
+}
+
+void sprite_world_fini(sprite_world *w) {
+	if (w->world)
+		ecs_fini(w->world);
+	w->world = NULL;
+	w->count = 0;
+}
+
+bool sprite_world_load(sprite_world *w, const sprite_store *store, int count) {
+	if (count > w->count) {
+		ecs_bulk_desc_t desc = {
+			.count = count - w->count,
+			.ids = {ecs_id(Position), ecs_id(Velocity), ecs_id(Depth), ecs_id(AtlasIndex)},
+		};
+		if (!ecs_bulk_init(w->world, &desc))
+			return false;
+		w->count = count;
+	}
+	ecs_run(w->world, w->load, 0.0f, (void *)store);
+	return true;
+}
+
+sprite_world_frame sprite_world_frame_for(sprite_store *store, const int *first, const int *count, int num_ranges) {
+	float m = store->margin;
+	return (sprite_world_frame){
+		.first = first,
+		.count = count,
+		.num_ranges = num_ranges,
+		.low_x = -m,
+		.high_x = (float)GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH + m,
+		.low_y = -m,
+		.high_y = (float)GSP_SCREEN_WIDTH - SPRITE_HEIGHT + m,
+		.store = store,
+	};
+}
+
+size_t sprite_world_progress(sprite_world *w, const sprite_world_frame *frame) {
+	w->frame = *frame;
+	w->frame.bytes = 0;
+	// The systems take their delta from the frame, so flecs' own is unused
+	ecs_progress(w->world, 1.0f);
+	return w->frame.bytes;
+}
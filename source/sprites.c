@@ -0,0 +1,133 @@
+#include <string.h>
+#include <stdlib.h>
+#include "sprites.h"
+
+float randbetween(float min, float max) {
+	return (float)rand() / RAND_MAX * (max - min) + min;
+}
+
+spriteinfo sprite_random(size_t num_subtextures) {
+	float width = GSP_SCREEN_HEIGHT_TOP - SPRITE_WIDTH;
+	float height = GSP_SCREEN_WIDTH - SPRITE_HEIGHT;
+
+	spriteinfo s = {randbetween(0, width), randbetween(0, height), randbetween(MIN_DEPTH, MAX_DEPTH), randbetween(-2, 2), randbetween(-2, 2), randbetween(0, num_subtextures)};
+	return s;
+}
+
+void add_rect(vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts) {
+	vertex vertex_list[] = {
+		{x, y, z, ts->left, ts->top},
+		{x + width, y, z, ts->right, ts->top},
+		{x, y + height, z, ts->left, ts->bottom},
+		{x, y + height, z, ts->left, ts->bottom},
+		{x + width, y, z, ts->right, ts->top},
+		{x + width, y + height, z, ts->right, ts->bottom},
+	};
+
+	memcpy(dest, vertex_list, sizeof(vertex_list));
+}
+
+void move_rect(vertex *dest, float x, float y, float z, float width, float height) {
+	dest[0].x = x;
+	dest[0].y = y;
+	dest[0].z = z;
+	dest[1].x = x + width;
+	dest[1].y = y;
+	dest[1].z = z;
+	dest[2].x = x;
+	dest[2].y = y + height;
+	dest[2].z = z;
+	dest[3].x = x;
+	dest[3].y = y + height;
+	dest[3].z = z;
+	dest[4].x = x + width;
+	dest[4].y = y;
+	dest[4].z = z;
+	dest[5].x = x + width;
+	dest[5].y = y + height;
+	dest[5].z = z;
+}
+
+void uv_rect(vertex *dest, const Tex3DS_SubTexture *ts) {
+	dest[0].u = ts->left;
+	dest[0].v = ts->top;
+	dest[1].u = ts->right;
+	dest[1].v = ts->top;
+	dest[2].u = ts->left;
+	dest[2].v = ts->bottom;
+	dest[3].u = ts->left;
+	dest[3].v = ts->bottom;
+	dest[4].u = ts->right;
+	dest[4].v = ts->top;
+	dest[5].u = ts->right;
+	dest[5].v = ts->bottom;
+}
+
+void add_quad(vertex *dest, float x, float y, float z, float width, float height, const Tex3DS_SubTexture *ts) {
+	vertex vertex_list[] = {
+		{x, y, z, ts->left, ts->top},
+		{x + width, y, z, ts->right, ts->top},
+		{x, y + height, z, ts->left, ts->bottom},
+		{x + width, y + height, z, ts->right, ts->bottom},
+	};
+
+	memcpy(dest, vertex_list, sizeof(vertex_list));
+}
+
+void move_quad(vertex *dest, float x, float y, float z, float width, float height) {
+	dest[0].x = x;
+	dest[0].y = y;
+	dest[0].z = z;
+	dest[1].x = x + width;
+	dest[1].y = y;
+	dest[1].z = z;
+	dest[2].x = x;
+	dest[2].y = y + height;
+	dest[2].z = z;
+	dest[3].x = x + width;
+	dest[3].y = y + height;
+	dest[3].z = z;
+}
+
+void uv_quad(vertex *dest, const Tex3DS_SubTexture *ts) {
+	dest[0].u = ts->left;
+	dest[0].v = ts->top;
+	dest[1].u = ts->right;
+	dest[1].v = ts->top;
+	dest[2].u = ts->left;
+	dest[2].v = ts->bottom;
+	dest[3].u = ts->right;
+	dest[3].v = ts->bottom;
+}
+
+void quad_indices(u16 *dest, int count) {
+	// Same two triangles as add_rect(): (0, 1, 2) and (2, 1, 3)
+	for (int i = 0; i < count; i++) {
+		u16 base = i * SPRITE_QUAD_VERTICES;
+		dest[0] = base;
+		dest[1] = base + 1;
+		dest[2] = base + 2;
+		dest[3] = base + 2;
+		dest[4] = base + 1;
+		dest[5] = base + 3;
+		dest += SPRITE_QUAD_INDICES;
+	}
+}
+
+void sprites_update(spriteinfo *sprites, vertex *vbo, int count, float delta) {
+	delta *= 6.0 / 100.0;
+	for (int i = 0; i < count; i++) {
+		spriteinfo *s = &sprites[i];
+		s->x += s->velocity_x * delta;
+		s->y += s->velocity_y * delta;
+
+		move_rect(&vbo[i * SPRITE_VERTICES], s->x, s->y, s->z, SPRITE_WIDTH, SPRITE_HEIGHT);
+
+		if (s->x < 0 || s->x + SPRITE_WIDTH > (float)GSP_SCREEN_HEIGHT_TOP) {
+			s->velocity_x *= -1;
+		}
+		if (s->y < 0 || s->y + SPRITE_HEIGHT > (float)GSP_SCREEN_WIDTH) {
+			s->velocity_y *= -1;
+		}
+	}
+}
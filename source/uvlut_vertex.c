@@ -0,0 +1,55 @@
+#include "uvlut_vertex.h"
+
+bool uvlut_table_for(uvlut_table *table, Tex3DS_Texture t3x) {
+	size_t entries = Tex3DS_GetNumSubTextures(t3x);
+	if (entries > UVLUT_ENTRIES)
+		return false;
+	for (size_t i = 0; i < entries; i++) {
+		const Tex3DS_SubTexture *ts = Tex3DS_GetSubTexture(t3x, i);
+		table->rect[i][0] = ts->left;
+		table->rect[i][1] = ts->top;
+		table->rect[i][2] = ts->right;
+		table->rect[i][3] = ts->bottom;
+	}
+	return true;
+}
+
+void add_uvlut_quad(uvlut_vertex *dest, float x, float y, float z, int entry) {
+	move_uvlut_quad(dest, x, y, z);
+	entry_uvlut_quad(dest, entry);
+	for (int i = 0; i < SPRITE_QUAD_VERTICES; i++) {
+		dest[i].corner_x = i & 1;
+		dest[i].corner_y = i >> 1;
+		dest[i].pad = 0;
+	}
+}
+
+void move_uvlut_quad(uvlut_vertex *dest, float x, float y, float z) {
+	for (int i = 0; i < SPRITE_QUAD_VERTICES; i++) {
+		dest[i].x = x;
+		dest[i].y = y;
+		dest[i].z = z;
+	}
+}
+
+void entry_uvlut_quad(uvlut_vertex *dest, int entry) {
+	for (int i = 0; i < SPRITE_QUAD_VERTICES; i++)
+		dest[i].entry = entry;
+}
+
+void sprite_store_emit_uvlut(const sprite_store *store, uvlut_vertex *vbo, int first, int count) {
+	for (int i = first; i < first + count; i++)
+		move_uvlut_quad(&vbo[i * SPRITE_QUAD_VERTICES], store->x[i], store->y[i], store->z[i]);
+}
+
+vertex uvlut_vertex_at(const uvlut_vertex *p, const uvlut_table *table, float width, float height) {
+	const float *rect = table->rect[p->entry];
+	vertex v = {
+		p->x + width * p->corner_x,
+		p->y + height * p->corner_y,
+		p->z,
+		rect[0] + (rect[2] - rect[0]) * p->corner_x,
+		rect[1] + (rect[3] - rect[1]) * p->corner_y,
+	};
+	return v;
+}